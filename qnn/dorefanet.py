@@ -64,6 +64,8 @@ _ffi = cffi.FFI()
 _ffi.cdef("void initParameters(unsigned int const batch, unsigned int const threads);")
 _ffi.cdef("void initAccelerator(char const *networkJson, char const *layerJson);")
 _ffi.cdef("void singleInference(char *in, size_t const inSize, char *out, size_t const outSize);")
+_ffi.cdef("int packedInference(unsigned char const *in, unsigned int const inChannels, unsigned int const inDim, float *out, unsigned int const outChannels, unsigned int const outDim);")
+_ffi.cdef("char const *getLastError();")
 _ffi.cdef("void deinitAccelerator();")
 
 
@@ -125,6 +127,28 @@ class Dorefanet:
 
         self.lib.singleInference(img_p, img.nbytes, out_p, out.nbytes);
 
+    def packed_inference(self, img, out):
+        """ Run inference on an unpacked image, replaces prepare_buffer, inference and postprocess_buffer.
+            img is a (chan, dim, dim) array of activation values, out a float32 (dim, dim, chan) array. """
+
+        if not self.init:
+            raise IOError("Hardware need to be initialized before inference!")
+
+        img = np.ascontiguousarray(img, dtype=np.uint8)
+        if out.dtype != np.float32 or not out.flags['C_CONTIGUOUS']:
+            raise IOError("packed inference needs a contiguous float32 output array!")
+        if img.ndim != 3 or img.shape[1] != img.shape[2]:
+            raise IOError("packed inference needs a (chan, dim, dim) input array!")
+        if out.ndim != 3 or out.shape[0] != out.shape[1]:
+            raise IOError("packed inference needs a (dim, dim, chan) output array!")
+
+        ffi = cffi.FFI()
+        img_p = ffi.cast('unsigned char const *', ffi.from_buffer(img))
+        out_p = ffi.cast('float *', ffi.from_buffer(out))
+
+        if self.lib.packedInference(img_p, img.shape[0], img.shape[1], out_p, out.shape[2], out.shape[0]) != 0:
+            raise RuntimeError(_ffi.string(self.lib.getLastError()).decode())
+
 
     def deinit_accelerator(self):
         """ De-allocate accelerator memory. """
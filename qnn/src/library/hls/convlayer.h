@@ -209,7 +209,8 @@ void StreamingConvLayer_Precision_SIMD_faster(
         const short unsigned int IFMDim,
         const short unsigned int PaddedDim,
         const short unsigned int OFMDim,
-        const short unsigned int Stride)
+        const short unsigned int Stride,
+        const short unsigned int Groups = 1)    // channel groups, each group of PEs sees its own input channel slice
 {
 #pragma HLS INLINE
 	hls::stream<ap_uint<MaxIFMChannels*Precision> > in_padded("StreamingConvLayer.in_padded");
@@ -236,7 +237,7 @@ void StreamingConvLayer_Precision_SIMD_faster(
             (swgIn, swgOut, KernelDim, PaddedDim, OFMDim, Stride, IFMCh);
 
     StreamingMatrixVector_Precision<MaxKernelDim * MaxKernelDim * MaxIFMChannels, MaxOFMChannels, MaxOFMDim*MaxOFMDim, SIMDWidth, PECount, WeightsPrecision, ThresholdPrecision, Precision, ActivationPrecision, MacPrecision, WMemCount, TMemCount, ActivationType>
-            (swgOut, mvOut, weightMem, thresMem, MatrixH, MatrixW, KernelDim * KernelDim * IFMCh, OFMDim * OFMDim);
+            (swgOut, mvOut, weightMem, thresMem, MatrixH, MatrixW, KernelDim * KernelDim * IFMCh, OFMDim * OFMDim, Groups, PaddedIFMCh / SIMDWidth);
 
     StreamingDataWidthConverter<MaxOFMDim * MaxOFMDim * (MaxOFMChannels / PECount), PECount*ActivationPrecision, MaxOFMChannels*ActivationPrecision>
             (mvOut, out, OFMDim * OFMDim * (MatrixH / PECount), PECount*ActivationPrecision, OFMCh*ActivationPrecision);
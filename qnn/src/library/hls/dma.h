@@ -87,6 +87,30 @@ void MemBuf2Stream(
 	}
 }
 
+// reads numBytes from in if enable is set, otherwise produces zeros without
+// touching memory, so the stream can stay in a dataflow region even if the
+// data is only needed for some layers
+template<unsigned int DataWidth, unsigned int MaxBytes>
+void Mem2StreamOptional(
+		ap_uint<DataWidth> *in,
+		hls::stream<ap_uint<DataWidth> > &out,
+		const unsigned int numBytes, const bool enable) {
+
+	CASSERT_DATAFLOW(DataWidth % 8 == 0);
+	const unsigned int numWords = numBytes / (DataWidth / 8);
+	CASSERT_DATAFLOW(numWords != 0);
+
+	assert(numWords <= (MaxBytes / (DataWidth / 8)));
+	for (unsigned int i = 0; i < numWords; i++) {
+#pragma HLS PIPELINE II=1
+		ap_uint<DataWidth> e = 0;
+		if (enable) {
+			e = in[i];
+		}
+		out.write(e);
+	}
+}
+
 template<unsigned int DataWidth, unsigned int MaxBytes>
 void Stream2Mem(
 		hls::stream<ap_uint<DataWidth> > &in,
@@ -180,7 +180,9 @@ void StreamingMatrixVector_Precision(
         const unsigned int MatrixH,           // height of matrix, multiple of PECount
         const unsigned int MatrixW,           // width of matrix, multiple of SIMDWidth
         const unsigned int realMatrixW,
-        const unsigned int KerShift = 1 )      // optional number of kernel shifts. 1 corresponds to fully-connected layer
+        const unsigned int KerShift = 1,      // optional number of kernel shifts. 1 corresponds to fully-connected layer
+        const unsigned int Groups = 1,        // optional number of channel groups, MatrixH and InChunks are multiples of it
+        const unsigned int InChunks = 0)      // SIMD chunks per kernel position, only used with more than one group
 {
     CASSERT_DATAFLOW(MatrixW % SIMDWidth == 0);
     CASSERT_DATAFLOW(MatrixH % PECount == 0);
@@ -193,6 +195,15 @@ void StreamingMatrixVector_Precision(
     // alternatively: number of horizontal matrix chunks
     const unsigned int synapseFold = MatrixW / SIMDWidth;
 
+    // grouped convolution: every neuron fold only sees the input channels of
+    // its group, the weights of a fold hold the group columns only. The first
+    // fold reads the whole input vector and accumulates the chunks of group 0,
+    // the other folds read back the chunks of their group from the buffer
+    const unsigned int rowChunks = (Groups > 1) ? InChunks : synapseFold;
+    const unsigned int groupChunks = rowChunks / Groups;
+    const unsigned int groupNeuronFold = neuronFold / Groups;
+    const unsigned int groupSynapseFold = synapseFold / Groups;
+
     // input vector buffer
     ap_uint<Precision * SIMDWidth> inputBuf[MaxWidth / SIMDWidth];
 
@@ -209,27 +220,39 @@ void StreamingMatrixVector_Precision(
 
     unsigned int nm = 0;
     unsigned int sf = 0;
-    const unsigned int totalFold = neuronFold * synapseFold * KerShift;
+    // synapse fold inside the group, the weight column
+    unsigned int gsf = 0;
+    // neuron fold inside the group
+    unsigned int gnm = 0;
+    // chunk inside the kernel position, first chunk of the kernel position
+    // and first chunk of the group in the input buffer
+    unsigned int chunk = 0;
+    unsigned int rowBase = 0;
+    unsigned int groupBase = 0;
+    const unsigned int totalFold = (synapseFold + ((neuronFold - 1) * groupSynapseFold)) * KerShift;
 
     for (unsigned int i = 0; i < totalFold; i++)
     {
 #pragma HLS PIPELINE II=1
         ap_uint<SIMDWidth * Precision> inElem;
+        const unsigned int bufIndex = rowBase + groupBase + chunk;
+        // chunks of the other groups are only read during the first fold
+        const bool active = chunk < groupChunks;
         if (nm == 0) {
             // read input from stream
             inElem = in.read();
             // buffer for reuse
-            inputBuf[sf] = inElem;
+            inputBuf[bufIndex] = inElem;
         } else {
             // reuse buffered input
-            inElem = inputBuf[sf];
+            inElem = inputBuf[bufIndex];
         }
 
         // compute matrix-vector product for each processing element
         for (unsigned int pe = 0; pe < PECount; pe++) {
 #pragma HLS UNROLL
 
-            ap_int<WeightsPrecision * SIMDWidth> memWeight =  weightMem[pe][nm * synapseFold + sf];
+            ap_int<WeightsPrecision * SIMDWidth> memWeight =  weightMem[pe][nm * groupSynapseFold + gsf];
             ap_int<MacPrecision> tmpMac = macRegisters[pe];
 
             for(unsigned int simd = 0; simd < SIMDWidth; simd++){
@@ -271,12 +294,22 @@ void StreamingMatrixVector_Precision(
                 tmpMac += tmpMul;
             }
 
-            macRegisters[pe] = tmpMac;
+            if (active) {
+                macRegisters[pe] = tmpMac;
+            }
         }
 
-
+        if (active) {
+            gsf++;
+        }
+        chunk++;
         sf++;
-        if(sf == synapseFold) {
+        if (chunk == ((nm == 0) ? rowChunks : groupChunks)) {
+            // next kernel position
+            chunk = 0;
+            rowBase += rowChunks;
+        }
+        if(sf == ((nm == 0) ? synapseFold : groupSynapseFold)) {
             ap_uint<PECount * ActivationPrecision> outElem = 0;
 
             for (unsigned int pe = 0; pe < PECount; pe++) {
@@ -301,12 +334,22 @@ void StreamingMatrixVector_Precision(
             out.write(outElem);
 
             sf = 0;
+            gsf = 0;
+            chunk = 0;
+            rowBase = 0;
             nm++;
+            gnm++;
+            if (gnm == groupNeuronFold) {
+                // next group
+                gnm = 0;
+                groupBase += groupChunks;
+            }
         }
 
         if (nm == neuronFold) {
             // next image
             nm = 0;
+            groupBase = 0;
         }
     }
 }
@@ -171,6 +171,52 @@ void StreamPadChannels(hls::stream<ap_uint<NumInChannels> > &in, hls::stream<ap_
     }
 }
 
+// Moves ChCount channels starting at channel ChOffset of every pixel to
+// channel 0 and clears the channels above, so one group of a grouped layer
+// is read directly from the shared activation buffer
+template<
+        unsigned int NumChannels,
+        unsigned int Precision
+        >
+void StreamSelectChannels(hls::stream<ap_uint<NumChannels * Precision> > &in,
+        hls::stream<ap_uint<NumChannels * Precision> > &out,
+        const unsigned int NumWords, const unsigned int ChOffset,
+        const unsigned int ChCount, const ap_uint<1> enable) {
+    const ap_uint<NumChannels * Precision> mask = (~ap_uint<NumChannels * Precision>(0)) >> ((NumChannels - ChCount) * Precision);
+    for (unsigned int i = 0; i < NumWords; i++) {
+#pragma HLS PIPELINE II=1
+        ap_uint<NumChannels * Precision> word = in.read();
+        if (enable) {
+            word = (word >> (ChOffset * Precision)) & mask;
+        }
+        out.write(word);
+    }
+}
+
+// Writes the ChCount lowest channels of every pixel into the channels
+// starting at ChOffset of the matching pixel from prev, so one group of a
+// grouped layer lands in its slice of the shared output buffer
+template<
+        unsigned int NumChannels,
+        unsigned int Precision
+        >
+void StreamInsertChannels(hls::stream<ap_uint<NumChannels * Precision> > &in,
+        hls::stream<ap_uint<NumChannels * Precision> > &prev,
+        hls::stream<ap_uint<NumChannels * Precision> > &out,
+        const unsigned int NumWords, const unsigned int ChOffset,
+        const unsigned int ChCount, const ap_uint<1> enable) {
+    const ap_uint<NumChannels * Precision> mask = (~ap_uint<NumChannels * Precision>(0)) >> ((NumChannels - ChCount) * Precision);
+    for (unsigned int i = 0; i < NumWords; i++) {
+#pragma HLS PIPELINE II=1
+        ap_uint<NumChannels * Precision> word = in.read();
+        ap_uint<NumChannels * Precision> old = prev.read();
+        if (enable) {
+            word = (old & ~(mask << (ChOffset * Precision))) | ((word & mask) << (ChOffset * Precision));
+        }
+        out.write(word);
+    }
+}
+
 // Reshape input stream to output only useful data when padding is VALID:
 // Might drop lines and columns at right and bottom
 template<
@@ -122,6 +122,89 @@ unsigned int GeneralUtils::padTo(unsigned int num, unsigned int padTo) {
     }
 }
 
+size_t GeneralUtils::getPageSize() {
+    long const pageSize = sysconf(_SC_PAGESIZE);
+    return (pageSize > 0) ? (size_t) pageSize : 4096;
+}
+
+/**
+ * Reads the default huge page size from /proc/meminfo
+ * @return huge page size in bytes, 2 MiB if it could not be determined
+ */
+size_t GeneralUtils::getHugePageSize() {
+    std::ifstream meminfo("/proc/meminfo");
+    std::string line;
+    while (std::getline(meminfo, line)) {
+        if (line.compare(0, 13, "Hugepagesize:") == 0) {
+            size_t const kiloBytes = std::strtoul(line.c_str() + 13, NULL, 10);
+            if (kiloBytes > 0) {
+                return kiloBytes * 1024;
+            }
+        }
+    }
+    return 2 * 1024 * 1024;
+}
+
+/**
+ * FNV-1a hash, chain several hashes by passing the previous one as seed
+ * @param  data data to hash
+ * @param  size size of data in bytes
+ * @param  seed start value
+ * @return      64 bit hash
+ */
+unsigned long long GeneralUtils::hash(char const *data, size_t size, unsigned long long seed) {
+    unsigned long long result = seed;
+    for (size_t i = 0; i < size; i++) {
+        result ^= (unsigned char) data[i];
+        result *= 0x100000001b3ULL;
+    }
+    return result;
+}
+
+unsigned long long GeneralUtils::hash(std::vector<char> const &data, unsigned long long seed) {
+    return GeneralUtils::hash(data.data(), data.size(), seed);
+}
+
+/**
+ * hashes the size, modification time and inode of a file, a cheap stand in
+ * for the content, any rewrite or replacement of the file changes it
+ * @param  path file to stat
+ * @param  seed start value
+ * @return      64 bit hash
+ */
+unsigned long long GeneralUtils::hashFileStat(std::string const &path, unsigned long long seed) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        throw std::runtime_error("Could not stat file " + path);
+    }
+    unsigned long long const stamp[] = { (unsigned long long) info.st_size, (unsigned long long) info.st_ino,
+        (unsigned long long) info.st_mtim.tv_sec, (unsigned long long) info.st_mtim.tv_nsec };
+    return GeneralUtils::hash((char const *) stamp, sizeof(stamp), seed);
+}
+
+/**
+ * lists the regular files of a directory
+ * @param  path directory
+ * @return      sorted file names
+ */
+std::vector<std::string> GeneralUtils::listDir(std::string const &path) {
+    std::vector<std::string> result;
+    DIR *dir = opendir(path.c_str());
+    if (dir == NULL) {
+        throw std::runtime_error("Could not open directory " + path);
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        std::string const name(entry->d_name);
+        if (GeneralUtils::fileExists(path + "/" + name)) {
+            result.push_back(name);
+        }
+    }
+    closedir(dir);
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
 bool GeneralUtils::fileExists(std::string const &path) {
     struct stat info;
     if ( stat(path.c_str(), &info) != 0 ) {
@@ -142,37 +225,109 @@ bool GeneralUtils::dirExists(std::string const &path) {
     return false;
 }
 
-void GeneralUtils::configureFabric(std::vector<char> const &buffer) {
-    if (GeneralUtils::fileExists("/dev/xdevcfg")) {
+/**
+ * Checks the state file for the bitstream, a record older than the last
+ * boot is ignored as the fabric was reset in between
+ * @param  record hash and size of the bitstream
+ * @param  paths  fabric locations
+ * @return        true if the bitstream is configured already
+ */
+bool GeneralUtils::_fabricLoaded(std::string const &record, GeneralUtils::FabricPaths const &paths) {
+    struct stat info;
+    if (stat(paths.state.c_str(), &info) != 0) {
+        return false;
+    }
+    std::ifstream uptimeFile("/proc/uptime");
+    double uptime = 0;
+    if (uptimeFile >> uptime) {
+        if (info.st_mtime < (time(NULL) - (time_t) uptime)) {
+            return false;
+        }
+    }
+    std::string loaded;
+    GeneralUtils::readStringFile(loaded, paths.state);
+    return loaded == record;
+}
+
+void GeneralUtils::_fabricRecord(std::string const &record, GeneralUtils::FabricPaths const &paths) {
+    std::ofstream state(paths.state, std::ios::out | std::ios::trunc);
+    state << record;
+}
+
+/**
+ * Polls the fpga_manager state until the fabric is operating, but at least
+ * for the settle time. The state still reads operating from the previous
+ * bitstream until the manager picks up the new one, a transition through
+ * the write states is not always visible to the poll
+ * @param paths fabric locations
+ */
+void GeneralUtils::_fabricWait(GeneralUtils::FabricPaths const &paths) {
+    std::string const statePath(paths.sysfs + "/state");
+    GeneralUtils::chrono_t timer = GeneralUtils::getTimer();
+    while (true) {
+        std::string state;
+        std::ifstream stateFile(statePath);
+        std::getline(stateFile, state);
+        signed long long const elapsed = GeneralUtils::getTime(timer);
+        if (state == "operating" && elapsed >= (signed long long) paths.settle * 1000) {
+            return;
+        } else if (state.find("err") != std::string::npos) {
+            throw std::runtime_error("Fabric configuration through fpga_manager failed with state " + state + "!");
+        } else if (elapsed > (signed long long) paths.timeout * 1000) {
+            throw std::runtime_error("Fabric configuration through fpga_manager timed out in state " + state + "!");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(FABRIC_POLL_MS));
+    }
+}
+
+/**
+ * Configures the fabric with the bitstream, unless the state file records
+ * the same bitstream as loaded since the last boot
+ * @param  buffer bitstream
+ * @param  paths  fabric locations
+ * @return        true if the fabric was reconfigured, false if the
+ *                bitstream is configured already
+ */
+bool GeneralUtils::configureFabric(std::vector<char> const &buffer, GeneralUtils::FabricPaths const &paths) {
+    std::ostringstream record;
+    record << std::hex << GeneralUtils::hash(buffer) << " " << std::dec << buffer.size();
+    if (GeneralUtils::_fabricLoaded(record.str(), paths)) {
+        return false;
+    }
+    // a failing configuration leaves the fabric in an unknown state
+    std::remove(paths.state.c_str());
+
+    if (GeneralUtils::fileExists(paths.devcfg)) {
         //We are on Kernel 4.6 or lower
-        FILE *fd = fopen("/dev/xdevcfg", "w");
+        FILE *fd = fopen(paths.devcfg.c_str(), "w");
         if (fd == NULL) {
-            throw std::runtime_error("Could not open /dev/xdevcfg device");
+            throw std::runtime_error("Could not open " + paths.devcfg + " device");
         }
         size_t written = fwrite(buffer.data(), sizeof(char), buffer.size(), fd);
+        fclose(fd);
         if (written != buffer.size()) {
-            throw std::runtime_error("Could not write complete bitstream to /dev/xdevcfg");
+            throw std::runtime_error("Could not write complete bitstream to " + paths.devcfg);
         }
-        fclose(fd);
-    } else if (GeneralUtils::fileExists("/sys/class/fpga_manager/fpga0/firmware")) {
+    } else if (GeneralUtils::fileExists(paths.sysfs + "/firmware")) {
         const char bitstreamFile[] = "fabric_bitstream.bin";
 
-        std::ofstream bitstream(std::string("/lib/firmware/") + bitstreamFile, std::ios::out | std::ios::binary | std::ios::trunc);
+        std::ofstream bitstream(paths.firmware + "/" + bitstreamFile, std::ios::out | std::ios::binary | std::ios::trunc);
         bitstream.write(buffer.data(), buffer.size());
         bitstream.close();
 
-        std::ofstream firmware("/sys/class/fpga_manager/fpga0/firmware");
+        std::ofstream firmware(paths.sysfs + "/firmware");
         firmware << bitstreamFile;
         firmware.close();
         if (!firmware.good()) {
             throw std::runtime_error("Fabric configuration through fpga_manager failed!");
         }
-        // Loading was successful, wait for half a second before using the fpga!
-        // or else the board is gone... praise the fpga_manager
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        // the board is gone if the fpga is used before the manager is done
+        GeneralUtils::_fabricWait(paths);
     } else {
-        // TODO load AWS bitstream
+        throw std::runtime_error("No supported fabric configuration interface found!");
     }
+    GeneralUtils::_fabricRecord(record.str(), paths);
+    return true;
 }
 
 void GeneralUtils::loadBitstreamFile(std::string const &bitstreamPath) {
@@ -41,13 +41,47 @@
 #include <fstream>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <dirent.h>
 #include <iostream>
 #include <thread>
+#include <algorithm>
+#include <sstream>
+#include <cstdio>
+#include <ctime>
+
+// FNV-1a 64 bit offset basis
+#define GENERALUTILS_HASH_SEED 0xcbf29ce484222325ULL
+
+// fabric configuration interfaces and the record of the loaded bitstream
+#define FABRIC_DEVCFG               "/dev/xdevcfg"
+#define FABRIC_SYSFS_ROOT           "/sys/class/fpga_manager/fpga0"
+#define FABRIC_FIRMWARE_ROOT        "/lib/firmware"
+#define FABRIC_STATE_FILE           "/tmp/qnn-fabric.state"
+#define FABRIC_TIMEOUT_MS           5000
+#define FABRIC_POLL_MS              5
+// the state reads operating from the previous bitstream right away
+#define FABRIC_SETTLE_MS            500
 
 
 class GeneralUtils {
     public:
         typedef std::chrono::high_resolution_clock::time_point chrono_t;
+
+        /**
+         * locations used by configureFabric, can point to a fake tree
+         */
+        struct FabricPaths {
+            FabricPaths() : devcfg(FABRIC_DEVCFG), sysfs(FABRIC_SYSFS_ROOT), firmware(FABRIC_FIRMWARE_ROOT),
+                state(FABRIC_STATE_FILE), timeout(FABRIC_TIMEOUT_MS), settle(FABRIC_SETTLE_MS) {};
+            std::string devcfg;
+            std::string sysfs;
+            std::string firmware;
+            std::string state;
+            unsigned int timeout;
+            unsigned int settle;
+        };
+
         static bool dirExists(std::string const &path);
         static bool fileExists(std::string const &path);
         static std::string dirname(std::string const &);
@@ -58,12 +92,21 @@ class GeneralUtils {
         static void readStringFile(std::string &, std::string const &);
         static std::vector<char> readBinaryFile(std::string const &);
         static void readBinaryFile(std::vector<char> &, std::string const &);
-        static void configureFabric(std::vector<char> const &buffer);
+        static bool configureFabric(std::vector<char> const &buffer, FabricPaths const &paths = FabricPaths());
         static void loadBitstreamFile(std::string const &);
         static unsigned int padTo(unsigned int , unsigned int );
+        static size_t getPageSize();
+        static size_t getHugePageSize();
+        static unsigned long long hash(char const *, size_t, unsigned long long = GENERALUTILS_HASH_SEED);
+        static unsigned long long hash(std::vector<char> const &, unsigned long long = GENERALUTILS_HASH_SEED);
+        static unsigned long long hashFileStat(std::string const &, unsigned long long = GENERALUTILS_HASH_SEED);
+        static std::vector<std::string> listDir(std::string const &);
         static signed long long getTime(chrono_t &);
         static chrono_t getTimer();
     private:
+        static bool _fabricLoaded(std::string const &, FabricPaths const &);
+        static void _fabricRecord(std::string const &, FabricPaths const &);
+        static void _fabricWait(FabricPaths const &);
         GeneralUtils() {};
         ~GeneralUtils() {};
 };
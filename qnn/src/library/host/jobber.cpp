@@ -108,6 +108,10 @@ void Jobber::wait() {
         });
 }
 
+unsigned int Jobber::workers() {
+    return this->_workers.size();
+}
+
 bool Jobber::running() {
     if (this->_jobs.size() == 0 && this->_running == 0) {
         return false;
@@ -58,6 +58,7 @@ class Jobber {
         bool work();
         void wait();
         bool running();
+        unsigned int workers();
 };
 
 
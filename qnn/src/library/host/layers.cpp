@@ -31,6 +31,127 @@
 
 #include "layers.h"
 
+namespace {
+    /**
+     * Binary execution plan, written by Layers::save:
+     *  PlanHeader
+     *  network, input image, verification image and binparam strings,
+     *  each one as uint32_t length and characters
+     *  PlanLayer[layers]
+     *  PlanStep[steps]
+     */
+    struct PlanHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t layers;
+        uint32_t steps;
+        uint32_t useBinparams;
+        uint64_t network;
+        uint32_t binparamSkip;
+        uint32_t layersSkip;
+        uint32_t outCh;
+        uint32_t outDim;
+        uint32_t outWords;
+        uint32_t outMem;
+        uint32_t inCh;
+        uint32_t inDim;
+        uint32_t inWords;
+        uint32_t inMem;
+        uint32_t maxBufferSize;
+        uint32_t maxIterations;
+        uint32_t maxSplit;
+        uint32_t reserved;
+    };
+
+    struct PlanLayer {
+        char function[32];
+        uint32_t layer;
+        uint32_t type;
+        uint32_t poolInDim;
+        uint32_t poolOutDim;
+        uint32_t poolStride;
+        uint32_t kernelDim;
+        uint32_t stride;
+        uint32_t log2stride;
+        uint32_t OFMCh;
+        uint32_t OFMDim;
+        uint32_t IFMCh;
+        uint32_t IFMDim;
+        double padding;
+        uint32_t paddedDim;
+        uint32_t convWMem;
+        uint32_t convTMem;
+        uint32_t convMemBits;
+        uint32_t convMem;
+        uint32_t inDim;
+        uint32_t inCh;
+        uint32_t outDim;
+        uint32_t outCh;
+        uint32_t outSize;
+        uint32_t inSize;
+        uint32_t outStride;
+        uint32_t inStride;
+        uint32_t inSplit;
+        uint32_t weightIndex;
+        uint32_t iterations;
+        uint32_t groups;
+        uint32_t split;
+        uint32_t merge;
+        uint32_t input;
+        uint32_t output;
+    };
+
+    struct PlanStep {
+        uint32_t layer;
+        uint32_t split;
+        uint32_t weightOffset;
+        uint32_t first;
+        uint32_t sliceIn;
+        uint32_t sliceOut;
+        uint32_t inOffset;
+        uint32_t outOffset;
+        uint32_t inStride;
+        uint32_t outStride;
+        uint32_t tileOutput;
+        uint32_t inSlot;
+        uint32_t outSlot;
+        uint32_t nextConv;
+    };
+
+    /**
+     * bounds checked reader of the plan content
+     */
+    class PlanReader {
+        public:
+            PlanReader(std::vector<char> const &content) : _content(content), _offset(0) {};
+
+            void read(void *target, size_t size) {
+                if (this->_offset + size > this->_content.size()) {
+                    throw std::runtime_error("Layers plan is truncated");
+                }
+                std::memcpy(target, &this->_content[this->_offset], size);
+                this->_offset += size;
+            }
+
+            std::string readString() {
+                uint32_t size = 0;
+                this->read(&size, sizeof(size));
+                std::string result(size, '\0');
+                this->read(&result[0], size);
+                return result;
+            }
+        private:
+            std::vector<char> const &_content;
+            size_t _offset;
+    };
+
+    void writeString(std::ofstream &file, std::string const &value) {
+        uint32_t const size = value.size();
+        file.write((char const *) &size, sizeof(size));
+        file.write(value.data(), size);
+    }
+}
+
 // Layers::Layers(Network &network, std::string const &jsonContent) :
 // _network(network), _outDim(0), _inDim(0), _maxBufferSize(0), _maxIterations(1), _maxSplit(0) {
 //     this->_layerJson.Parse(jsonContent.c_str());
@@ -42,14 +163,29 @@
 
 Layers::Layers(Network &network, std::string const &filePath, std::vector<char> const &jsonContent) :
     _noneLayer(*this, network), _network(network), _outDim(0), _inDim(0), _maxBufferSize(0), _maxIterations(1), _maxSplit(0),
-    _jsonFolder(GeneralUtils::dirname(GeneralUtils::abspath(filePath))) {
+    _jsonFolder(GeneralUtils::dirname(GeneralUtils::abspath(filePath))), _hash(GeneralUtils::hash(jsonContent)),
+    _useBinparams(false), _binparamSkip(0), _layersSkip(0) {
+    this->_noneLayer.function = "none";
+    if (jsonContent.size() >= sizeof(LAYERS_PLAN_MAGIC) && std::memcmp(jsonContent.data(), LAYERS_PLAN_MAGIC, sizeof(LAYERS_PLAN_MAGIC)) == 0) {
+        // compiled plan, nothing to parse or derive
+        this->_loadPlan(jsonContent);
+        return;
+    }
     std::string jsonString(jsonContent.begin(), jsonContent.end());
     this->_layerJson.Parse(jsonString.c_str());
     if (!this->_validateJson()) {
         throw std::runtime_error("Layers json is no layers compatible json file");
     }
+    this->_networkName = this->_layerJson["network"].GetString();
+    this->_inputImage = this->_layerJson["input_image"].GetString();
+    this->_verificationImage = this->_layerJson["verification_image"].GetString();
+    this->_binparam = this->_layerJson["binparam"].GetString();
+    this->_useBinparams = this->_layerJson["use_binparams"].GetBool();
+    this->_binparamSkip = this->_layerJson["binparam_skip"].GetInt();
+    this->_layersSkip = this->_layerJson["layer_skip"].GetInt();
     this->_parseLayers();
-    this->_noneLayer.function = "none";
+    this->_groupLayers();
+    this->_buildSteps();
 }
 
 Layers::Layers(Network &network, std::string const &jsonFilepath) : Layers(network, jsonFilepath, GeneralUtils::readBinaryFile(jsonFilepath)) {}
@@ -165,11 +301,7 @@ void Layers::_parseLayers() {
     unsigned int const maxIFMCh         = this->_network.getMaxIFMCh();
     unsigned int const maxIFMDim        = this->_network.getMaxIFMDim();
     unsigned int const maxOFMCh         = this->_network.getMaxOFMCh();
-    unsigned int const maxPEConv        = this->_network.getMaxPEConv();
-    unsigned int const maxSIMD          = this->_network.getMaxSIMD();
     unsigned int const datawidth        = this->_network.getDatawidth();
-    unsigned int const memChannls       = this->_network.getMemChannels();
-    unsigned int const treshholdsBits   = this->_network.getTreshholdsBits();
     unsigned int const activationBits   = this->_network.getActivationBits();
     unsigned int const layerSkip        = this->getLayersSkip();
 
@@ -202,11 +334,6 @@ void Layers::_parseLayers() {
                 layer.IFMDim = (unsigned int) layers[i]["input"][1].GetInt();
                 layer.padding = (double) layers[i]["padding"].GetDouble();
                 layer.paddedDim = layer.IFMDim + (2 * layer.padding);
-                //the next 2 are not in bytes, maybe rename this parameters:
-                layer.convWMem = ((layer.kernelDim * layer.kernelDim * maxOFMCh * maxIFMCh) / (maxPEConv * maxSIMD));
-                layer.convTMem = maxOFMCh / maxPEConv;
-                layer.convMemBits = datawidth * maxPEConv * (layer.convWMem + (layer.convTMem * std::ceil(treshholdsBits / datawidth)));
-                layer.convMem = (layer.convMemBits / memChannls / 8);
                 layer.poolInDim = layer.OFMDim;
                 layer.poolOutDim = layer.OFMDim;
                 layer.poolStride = 0;
@@ -215,6 +342,7 @@ void Layers::_parseLayers() {
                     layer.iterations = (unsigned int) std::ceil((float) layer.OFMCh / (float) maxOFMCh);
                     layer.OFMCh = (unsigned int) std::ceil(layer.OFMCh/layer.iterations);
                 }
+                this->_weightMemory(layer);
                 // This is not redundant, IFM and OFM are for the convolutional
                 // layer, which can be combined with a maxpool in which the
                 // output dimension can be changed!
@@ -287,8 +415,7 @@ void Layers::_parseLayers() {
             }
 
             // Calculate general layer values
-            layer.inSize = ((activationBits * maxIFMCh * layer.inDim * layer.inDim) / 8);
-            layer.outSize = ((activationBits * maxIFMCh * layer.outDim * layer.outDim) / 8);
+            this->_activationMemory(layer);
 
             if (add) {
                 this->_outDim = layer.outDim;
@@ -317,9 +444,9 @@ void Layers::_parseLayers() {
         throw;
     }
     this->_maxBufferSize =  GeneralUtils::padTo((activationBits * maxIFMCh * maxDim * maxDim) / 8, apintPadding);
-    this->_outMem = GeneralUtils::padTo((activationBits * maxIFMCh * this->_outDim * this->_outDim) / 8, apintPadding);
+    this->_outMem = GeneralUtils::padTo(this->getPixelBytes(this->_outCh) * this->_outDim * this->_outDim, apintPadding);
     this->_outWords = this->_outMem / (datawidth / 8);
-    this->_inMem = GeneralUtils::padTo((activationBits * maxIFMCh * this->_inDim * this->_inDim) / 8, apintPadding);
+    this->_inMem = GeneralUtils::padTo(this->getPixelBytes(this->_inCh) * this->_inDim * this->_inDim, apintPadding);
     this->_inWords = this->_inMem / (datawidth / 8);
 }
 
@@ -351,6 +478,19 @@ unsigned int Layers::getOutMem() {
     return this->_outMem;
 };
 
+/**
+ * bytes of one pixel in an activation buffer. Compact buffers hold the
+ * channels rounded to whole memory words, all others MAX_IFM_CH channels
+ * @param channels channels of the buffer
+ */
+unsigned int Layers::getPixelBytes(unsigned int channels) {
+    unsigned int const activationBits = this->_network.getActivationBits();
+    if (this->_network.hasCompactActivations()) {
+        return GeneralUtils::padTo(((activationBits * channels) + 7) / 8, this->_network.getDatawidth() / 8);
+    }
+    return GeneralUtils::padTo((activationBits * this->_network.getMaxIFMCh()) / 8, apintPadding);
+}
+
 unsigned int Layers::getInCh() {
     return this->_inCh;
 };
@@ -368,34 +508,449 @@ unsigned int Layers::getInMem() {
 };
 
 std::string Layers::getNetwork() {
-    return std::string(this->_layerJson["network"].GetString());
+    return this->_networkName;
 };
 
 bool Layers::useBinparams() {
-    return this->_layerJson["use_binparams"].GetBool();
+    return this->_useBinparams;
 };
 
 unsigned int Layers::getBinparamSkip() {
-    return this->_layerJson["binparam_skip"].GetInt();
+    return this->_binparamSkip;
 };
 
 unsigned int Layers::getLayersSkip() {
-    return this->_layerJson["layer_skip"].GetInt();
-
+    return this->_layersSkip;
 };
 
 std::string Layers::getInputImagePath() {
-    return GeneralUtils::abspathReference(this->_layerJson["input_image"].GetString(), this->_jsonFolder);
+    return GeneralUtils::abspathReference(this->_inputImage, this->_jsonFolder);
 };
 
 std::string Layers::getVerificationImagePath() {
-    return GeneralUtils::abspathReference(this->_layerJson["verification_image"].GetString(), this->_jsonFolder);
+    return GeneralUtils::abspathReference(this->_verificationImage, this->_jsonFolder);
 };
 
 std::string Layers::getBinparamPath() {
-    return GeneralUtils::abspathReference(this->_layerJson["binparam"].GetString(), this->_jsonFolder) + "/";
+    return GeneralUtils::abspathReference(this->_binparam, this->_jsonFolder) + "/";
+};
+
+std::string Layers::getBinparamPackPath() {
+    return GeneralUtils::abspathReference(this->_binparam, this->_jsonFolder);
 };
 
+/**
+ * a binparam entry pointing to a regular file instead of a directory is a
+ * weight pack created with the testbench option -w
+ */
+bool Layers::useBinparamPack() {
+    return GeneralUtils::fileExists(this->getBinparamPackPath());
+};
+
+/**
+ * hashes the names, sizes and modification times of all binparam files or
+ * of the weight pack, the weight data itself is not read so a cache lookup
+ * stays cheap
+ * @return hash of the binparams
+ */
+unsigned long long Layers::getBinparamHash() {
+    if (this->useBinparamPack()) {
+        return GeneralUtils::hashFileStat(this->getBinparamPackPath());
+    }
+    std::string const dataRoot = this->getBinparamPath();
+    unsigned long long result = GENERALUTILS_HASH_SEED;
+    for (auto const &name : GeneralUtils::listDir(dataRoot)) {
+        result = GeneralUtils::hash(name.c_str(), name.size(), result);
+        result = GeneralUtils::hashFileStat(dataRoot + name, result);
+    }
+    return result;
+};
+
+/**
+ * @return hash of the layers json content
+ */
+unsigned long long Layers::getHash() {
+    return this->_hash;
+};
+
+/**
+ * replaces split, conv, merge sequences by one grouped conv layer, if the
+ * hardware computes grouped convolutions. The grouped layer keeps the first
+ * weight index of the split run and loads all groups in one weight row, the
+ * weight indices of the following layers move down accordingly. Sequences
+ * with more than one conv layer, multi iteration layers or groups that do
+ * not fill whole SIMD and PE folds stay split/merge emulated
+ */
+void Layers::_groupLayers() {
+    if (!this->_network.hasGroupedConv()) {
+        return;
+    }
+    unsigned int const maxIFMCh     = this->_network.getMaxIFMCh();
+    unsigned int const maxOFMCh     = this->_network.getMaxOFMCh();
+    unsigned int const maxPEConv    = this->_network.getMaxPEConv();
+    unsigned int const maxSIMD      = this->_network.getMaxSIMD();
+    unsigned int weightShift = 0;
+    std::vector<Layers::Layer> layers;
+    for (unsigned int i = 0; i < this->_layers.size(); i++) {
+        Layers::Layer layer = this->_layers[i];
+        layer.weightIndex -= (layer.layer & Layers::conv) ? weightShift : 0;
+        if ((layer.layer & Layers::split) && (i + 2) < this->_layers.size()) {
+            Layers::Layer const &conv = this->_layers[i + 1];
+            Layers::Layer const &merge = this->_layers[i + 2];
+            unsigned int const groups = layer.split;
+            if ((conv.layer & Layers::conv) && (merge.layer & Layers::merge) &&
+                (merge.merge == groups) && (conv.iterations == 1) &&
+                (conv.IFMCh % maxSIMD == 0) && (conv.OFMCh % maxPEConv == 0) &&
+                (conv.IFMCh * groups <= maxIFMCh) && (conv.OFMCh * groups <= maxOFMCh)) {
+                Layers::Layer grouped = conv;
+                grouped.weightIndex -= weightShift;
+                grouped.groups = groups;
+                grouped.IFMCh *= groups;
+                grouped.OFMCh *= groups;
+                grouped.inCh = layer.inCh;
+                grouped.outCh = merge.outCh;
+                grouped.split = 0;
+                grouped.inSplit = false;
+                this->_weightMemory(grouped);
+                this->_activationMemory(grouped);
+                layers.push_back(grouped);
+                weightShift += groups - 1;
+                i += 2;
+                continue;
+            }
+        }
+        layers.push_back(layer);
+    }
+    this->_layers.swap(layers);
+    this->_maxSplit = 0;
+    for (auto const &layer : this->_layers) {
+        this->_maxSplit = (layer.split > this->_maxSplit) ? layer.split : this->_maxSplit;
+    }
+}
+
+/**
+ * sizes the weight memory block of a conv layer. Hardware with exact weight
+ * loading streams the weights and treshholds of the padded layer shape, the
+ * per PE entries are a prefix of the binparam files. Older bitstreams always
+ * stream the memory of the maximum shape
+ * @param layer conv layer, channels and groups are set
+ */
+void Layers::_weightMemory(Layers::Layer &layer) {
+    unsigned int const maxPEConv        = this->_network.getMaxPEConv();
+    unsigned int const maxSIMD          = this->_network.getMaxSIMD();
+    unsigned int const datawidth        = this->_network.getDatawidth();
+    unsigned int const memChannls       = this->_network.getMemChannels();
+    unsigned int const treshholdsBits   = this->_network.getTreshholdsBits();
+    unsigned int IFMCh = this->_network.getMaxIFMCh();
+    unsigned int OFMCh = this->_network.getMaxOFMCh();
+    if (this->_network.hasExactWeights()) {
+        // every neuron fold of a grouped layer holds the columns of its group only
+        IFMCh = GeneralUtils::padTo(layer.IFMCh, maxSIMD) / layer.groups;
+        OFMCh = GeneralUtils::padTo(layer.OFMCh, maxPEConv);
+    }
+    //the next 2 are not in bytes, maybe rename this parameters:
+    layer.convWMem = ((layer.kernelDim * layer.kernelDim * OFMCh * IFMCh) / (maxPEConv * maxSIMD));
+    layer.convTMem = OFMCh / maxPEConv;
+    layer.convMemBits = datawidth * maxPEConv * (layer.convWMem + (layer.convTMem * std::ceil(treshholdsBits / datawidth)));
+    layer.convMem = (layer.convMemBits / memChannls / 8);
+}
+
+/**
+ * sizes the input and output buffers of a layer. The output of a multi
+ * iteration layer holds the channels of all iterations, so the iterations
+ * and the concatenated result share one pixel layout
+ * @param layer layer, channels, dimensions and iterations are set
+ */
+void Layers::_activationMemory(Layers::Layer &layer) {
+    layer.inStride = this->getPixelBytes(layer.inCh);
+    layer.outStride = this->getPixelBytes(layer.outCh * layer.iterations);
+    layer.inSize = layer.inStride * layer.inDim * layer.inDim;
+    layer.outSize = layer.outStride * layer.outDim * layer.outDim;
+}
+
+/**
+ * @return flat execution order of the split and conv layers
+ */
+std::vector<Layers::Step> const &Layers::getSteps() const {
+    return this->_steps;
+}
+
+/**
+ * unrolls the split/merge runs once, so inference does not need to jump
+ * back to the split layer
+ */
+void Layers::_buildSteps() {
+    bool splitMode = false;
+    unsigned int splitStart = 0;
+    unsigned int splitIndex = 0;
+    unsigned int weightOffset = 0;
+    unsigned int index = 0;
+    this->_steps.clear();
+    while (index < this->_layers.size()) {
+        Layers::Layer const &layer = this->_layers[index];
+        if (layer.layer & Layers::split) {
+            this->_steps.push_back({index, splitIndex, weightOffset, !splitMode});
+            if (!splitMode) {
+                splitStart = index;
+                splitMode = true;
+                splitIndex = 0;
+                weightOffset = 0;
+            }
+        } else if (layer.layer & Layers::merge) {
+            if (splitMode && splitIndex < layer.merge - 1) {
+                splitIndex++;
+                weightOffset += layer.weightIndex;
+                index = splitStart;
+                continue;
+            }
+            splitMode = false;
+            splitIndex = 0;
+            weightOffset = 0;
+        } else if (layer.layer & Layers::conv) {
+            this->_steps.push_back({index, splitIndex, weightOffset, false});
+        }
+        index++;
+    }
+    this->_planSteps();
+}
+
+/**
+ * a conv layer right after a split reads its channel group from the split
+ * source, if the hardware supports channel slices and the group is done in
+ * a single iteration
+ * @param layerIndex index of the conv layer
+ */
+bool Layers::_sliceInput(unsigned int layerIndex) {
+    return this->_network.hasChannelSlice() && (layerIndex > 0) && (layerIndex < this->_layers.size()) &&
+        (this->_layers[layerIndex - 1].layer & Layers::split) &&
+        (this->_layers[layerIndex].iterations == 1);
+}
+
+/**
+ * a conv layer right before a merge writes its channel group into the
+ * merge buffer, see _sliceInput
+ * @param layerIndex index of the conv layer
+ */
+bool Layers::_sliceOutput(unsigned int layerIndex) {
+    return this->_network.hasChannelSlice() && ((layerIndex + 1) < this->_layers.size()) &&
+        (this->_layers[layerIndex + 1].layer & Layers::merge) &&
+        (this->_layers[layerIndex].iterations == 1);
+}
+
+/**
+ * resolves the channel slices, buffer slots and the next conv step of all
+ * steps, walking backwards so every step sees its successor
+ */
+void Layers::_planSteps() {
+    unsigned int nextConv = this->_steps.size();
+    for (unsigned int i = this->_steps.size(); i-- > 0;) {
+        Layers::Step &step = this->_steps[i];
+        Layers::Layer const &layer = this->_layers[step.layer];
+        step.nextConv = nextConv;
+        if (layer.layer & Layers::split) {
+            step.sliceIn = this->_sliceInput(step.layer + 1);
+            continue;
+        }
+        nextConv = i;
+        step.sliceIn = this->_sliceInput(step.layer);
+        step.sliceOut = this->_sliceOutput(step.layer);
+        if (step.sliceIn) {
+            Layers::Layer const &source = this->_layers[step.layer - 1];
+            step.inOffset = step.split * source.outCh;
+            // sliced buffers are laid out like the split source and merge result
+            step.inStride = source.inStride;
+        }
+        if (step.sliceOut) {
+            Layers::Layer const &target = this->_layers[step.layer + 1];
+            step.outOffset = step.split * target.inCh;
+            step.outStride = target.outStride;
+        }
+        step.tileOutput = this->_network.hasChannelSlice() && (layer.iterations > 1);
+        step.inSlot = step.sliceIn ? Layers::slot_split : Layers::slot_result;
+        step.outSlot = step.tileOutput ? Layers::slot_concat :
+            step.sliceOut ? Layers::slot_merge : Layers::slot_hardware;
+    }
+}
+
+/**
+ * writes the parsed layers and the execution steps as binary plan, which
+ * can be loaded in place of the layers json, see _loadPlan
+ * @param path target file
+ */
+void Layers::save(std::string const &path) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("Cannot write layers plan " + path);
+    }
+    PlanHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, LAYERS_PLAN_MAGIC, sizeof(LAYERS_PLAN_MAGIC));
+    header.version = LAYERS_PLAN_VERSION;
+    header.layers = this->_layers.size();
+    header.steps = this->_steps.size();
+    header.useBinparams = this->_useBinparams;
+    header.network = this->_network.getHash();
+    header.binparamSkip = this->_binparamSkip;
+    header.layersSkip = this->_layersSkip;
+    header.outCh = this->_outCh;
+    header.outDim = this->_outDim;
+    header.outWords = this->_outWords;
+    header.outMem = this->_outMem;
+    header.inCh = this->_inCh;
+    header.inDim = this->_inDim;
+    header.inWords = this->_inWords;
+    header.inMem = this->_inMem;
+    header.maxBufferSize = this->_maxBufferSize;
+    header.maxIterations = this->_maxIterations;
+    header.maxSplit = this->_maxSplit;
+    file.write((char const *) &header, sizeof(header));
+    // relative paths stay relative to the plan, like in the json
+    writeString(file, this->_networkName);
+    writeString(file, this->_inputImage);
+    writeString(file, this->_verificationImage);
+    writeString(file, this->_binparam);
+    for (auto const &layer : this->_layers) {
+        PlanLayer record;
+        std::memset(&record, 0, sizeof(record));
+        std::strncpy(record.function, layer.function.c_str(), sizeof(record.function) - 1);
+        record.layer = layer.layer;
+        record.type = layer.type;
+        record.poolInDim = layer.poolInDim;
+        record.poolOutDim = layer.poolOutDim;
+        record.poolStride = layer.poolStride;
+        record.kernelDim = layer.kernelDim;
+        record.stride = layer.stride;
+        record.log2stride = layer.log2stride;
+        record.OFMCh = layer.OFMCh;
+        record.OFMDim = layer.OFMDim;
+        record.IFMCh = layer.IFMCh;
+        record.IFMDim = layer.IFMDim;
+        record.padding = layer.padding;
+        record.paddedDim = layer.paddedDim;
+        record.convWMem = layer.convWMem;
+        record.convTMem = layer.convTMem;
+        record.convMemBits = layer.convMemBits;
+        record.convMem = layer.convMem;
+        record.inDim = layer.inDim;
+        record.inCh = layer.inCh;
+        record.outDim = layer.outDim;
+        record.outCh = layer.outCh;
+        record.outSize = layer.outSize;
+        record.inSize = layer.inSize;
+        record.outStride = layer.outStride;
+        record.inStride = layer.inStride;
+        record.inSplit = layer.inSplit;
+        record.weightIndex = layer.weightIndex;
+        record.iterations = layer.iterations;
+        record.groups = layer.groups;
+        record.split = layer.split;
+        record.merge = layer.merge;
+        record.input = layer.input;
+        record.output = layer.output;
+        file.write((char const *) &record, sizeof(record));
+    }
+    for (auto const &step : this->_steps) {
+        PlanStep record = {step.layer, step.split, step.weightOffset, step.first, step.sliceIn, step.sliceOut,
+            step.inOffset, step.outOffset, step.inStride, step.outStride, step.tileOutput, step.inSlot, step.outSlot,
+            step.nextConv};
+        file.write((char const *) &record, sizeof(record));
+    }
+    if (!file) {
+        throw std::runtime_error("Cannot write layers plan " + path);
+    }
+}
+
+/**
+ * restores the layers and steps written by save, the plan is only valid
+ * for the network it was compiled against
+ * @param content plan file content
+ */
+void Layers::_loadPlan(std::vector<char> const &content) {
+    PlanReader reader(content);
+    PlanHeader header;
+    reader.read(&header, sizeof(header));
+    if (header.version != LAYERS_PLAN_VERSION) {
+        throw std::runtime_error("Layers plan version " + std::to_string(header.version) + " is not supported");
+    }
+    if (header.network != this->_network.getHash()) {
+        throw std::runtime_error("Layers plan was compiled for a different network");
+    }
+    this->_useBinparams = header.useBinparams;
+    this->_binparamSkip = header.binparamSkip;
+    this->_layersSkip = header.layersSkip;
+    this->_outCh = header.outCh;
+    this->_outDim = header.outDim;
+    this->_outWords = header.outWords;
+    this->_outMem = header.outMem;
+    this->_inCh = header.inCh;
+    this->_inDim = header.inDim;
+    this->_inWords = header.inWords;
+    this->_inMem = header.inMem;
+    this->_maxBufferSize = header.maxBufferSize;
+    this->_maxIterations = header.maxIterations;
+    this->_maxSplit = header.maxSplit;
+    this->_networkName = reader.readString();
+    this->_inputImage = reader.readString();
+    this->_verificationImage = reader.readString();
+    this->_binparam = reader.readString();
+    this->_layers.clear();
+    this->_layers.reserve(header.layers);
+    for (uint32_t i = 0; i < header.layers; i++) {
+        PlanLayer record;
+        reader.read(&record, sizeof(record));
+        record.function[sizeof(record.function) - 1] = '\0';
+        struct Layer::Layer layer(*this, this->_network);
+        layer.function = std::string(record.function);
+        layer.layer = record.layer;
+        layer.type = record.type;
+        layer.poolInDim = record.poolInDim;
+        layer.poolOutDim = record.poolOutDim;
+        layer.poolStride = record.poolStride;
+        layer.kernelDim = record.kernelDim;
+        layer.stride = record.stride;
+        layer.log2stride = record.log2stride;
+        layer.OFMCh = record.OFMCh;
+        layer.OFMDim = record.OFMDim;
+        layer.IFMCh = record.IFMCh;
+        layer.IFMDim = record.IFMDim;
+        layer.padding = record.padding;
+        layer.paddedDim = record.paddedDim;
+        layer.convWMem = record.convWMem;
+        layer.convTMem = record.convTMem;
+        layer.convMemBits = record.convMemBits;
+        layer.convMem = record.convMem;
+        layer.inDim = record.inDim;
+        layer.inCh = record.inCh;
+        layer.outDim = record.outDim;
+        layer.outCh = record.outCh;
+        layer.outSize = record.outSize;
+        layer.inSize = record.inSize;
+        layer.outStride = record.outStride;
+        layer.inStride = record.inStride;
+        layer.inSplit = record.inSplit;
+        layer.weightIndex = record.weightIndex;
+        layer.iterations = record.iterations;
+        layer.groups = record.groups;
+        layer.split = record.split;
+        layer.merge = record.merge;
+        layer.input = record.input;
+        layer.output = record.output;
+        this->_layers.push_back(layer);
+    }
+    this->_steps.clear();
+    this->_steps.reserve(header.steps);
+    for (uint32_t i = 0; i < header.steps; i++) {
+        PlanStep record;
+        reader.read(&record, sizeof(record));
+        if (record.layer >= this->_layers.size() || record.nextConv > header.steps) {
+            throw std::runtime_error("Layers plan step " + std::to_string(i) + " references a missing layer or step");
+        }
+        this->_steps.push_back({record.layer, record.split, record.weightOffset, record.first != 0,
+            record.sliceIn != 0, record.sliceOut != 0, record.inOffset, record.outOffset, record.inStride,
+            record.outStride, record.tileOutput != 0, record.inSlot, record.outSlot, record.nextConv});
+    }
+}
+
 struct Layers::Layer &Layers::getLayer(unsigned int layerIndex) {
     return _layers[layerIndex];
 }
@@ -39,12 +39,17 @@
 #include <limits.h>
 #include <stdlib.h>
 #include <iostream>
+#include <cstring>
+#include <stdint.h>
 
 #include "rapidjson/document.h"
 #include "general-utils.h"
 #include "network.h"
 #include "platform.h"
 
+#define LAYERS_PLAN_MAGIC       "QNNPLAN"
+#define LAYERS_PLAN_VERSION     4
+
 class Layers {
     public:
         // The next values are used by hardware offload, they are fixed internal
@@ -60,14 +65,21 @@ class Layers {
         static unsigned int const merge     = 8;
         static unsigned int const fc        = 16;
 
+        // The next values are the buffers a conv step reads and writes
+        static unsigned int const slot_result   = 0;
+        static unsigned int const slot_split    = 1;
+        static unsigned int const slot_concat   = 2;
+        static unsigned int const slot_merge    = 3;
+        static unsigned int const slot_hardware = 4;
+
         struct Layer {
             Layer(Layers &layers, Network &network) : parent(layers), network(network),
             layer(0), type(Layers::none), poolInDim(0), poolOutDim(0), poolStride(0),
             kernelDim(0), stride(0), log2stride(0), OFMCh(0), OFMDim(0),
             IFMCh(0), IFMDim(0), padding(0), paddedDim(0), convWMem(0), convTMem(0),
             convMemBits(0), convMem(0), inDim(0), inCh(0), outDim(0), outCh(0),
-            outSize(0), inSize(0), inSplit(false), weightIndex(0), iterations(1),
-            split(0), merge(0), input(0), output(0) {};
+            outSize(0), inSize(0), outStride(0), inStride(0), inSplit(false), weightIndex(0), iterations(1),
+            groups(1), split(0), merge(0), input(0), output(0) {};
             Layers &parent;
             Network &network;
             std::string function;
@@ -97,11 +109,16 @@ class Layers {
             unsigned int outCh;
             unsigned int outSize;
             unsigned int inSize;
+            //bytes per pixel of the output and input buffers
+            unsigned int outStride;
+            unsigned int inStride;
             bool inSplit;
             //which weights should be used for this layer
             unsigned int weightIndex;
             //multi iteration layer
             unsigned int iterations;
+            //grouped convolution, IFMCh and OFMCh are split in this many groups
+            unsigned int groups;
             //for split layers
             unsigned int split;
             //for merge layers
@@ -111,6 +128,40 @@ class Layers {
             unsigned int output;
         };
 
+        /**
+         * one step of the flat execution order, split/merge runs are
+         * unrolled, so inference walks the steps front to back. The channel
+         * slice registers and buffer slots of conv steps are resolved once
+         * when the steps are built
+         */
+        struct Step {
+            //index of the split or conv layer
+            unsigned int layer;
+            //split run the step belongs to
+            unsigned int split;
+            //weight index offset of the split run
+            unsigned int weightOffset;
+            //split layer of the first split run, does the actual split
+            bool first;
+            //conv reads its channel group from the split source, for split
+            //steps the following conv layer does
+            bool sliceIn;
+            //conv writes its channel group into the merge buffer
+            bool sliceOut;
+            //channel slice registers
+            unsigned int inOffset;
+            unsigned int outOffset;
+            unsigned int inStride;
+            unsigned int outStride;
+            //iterations write their output tiles into the concat buffer
+            bool tileOutput;
+            //buffer slots the conv step reads and writes
+            unsigned int inSlot;
+            unsigned int outSlot;
+            //next conv step, the step count if there is none
+            unsigned int nextConv;
+        };
+
         Layers(Network &, std::string const &, std::vector<char> const &);
         Layers(Network &, std::string const &);
         ~Layers();
@@ -136,12 +187,19 @@ class Layers {
         unsigned int getOutDim();
         unsigned int getOutWords();
         unsigned int getOutMem();
+        unsigned int getPixelBytes(unsigned int);
         std::string getNetwork();
         std::string getInputImagePath();
         std::string getVerificationImagePath();
         std::string getBinparamPath();
+        std::string getBinparamPackPath();
+        bool useBinparamPack();
+        unsigned long long getBinparamHash();
+        unsigned long long getHash();
         unsigned int getBinparamSkip();
         unsigned int getLayersSkip();
+        std::vector<Layers::Step> const &getSteps() const;
+        void save(std::string const &);
 
 #define DEBUG 1
 #ifdef DEBUG
@@ -173,8 +231,11 @@ class Layers {
                 std::cout << "outCh:        " << layer.outCh << std::endl;
                 std::cout << "outSize:      " << layer.outSize << std::endl;
                 std::cout << "inSize:       " << layer.inSize << std::endl;
+                std::cout << "outStride:    " << layer.outStride << std::endl;
+                std::cout << "inStride:     " << layer.inStride << std::endl;
                 std::cout << "weightIndex:  " << layer.weightIndex << std::endl;
                 std::cout << "iterations:   " << layer.iterations << std::endl;
+                std::cout << "groups:       " << layer.groups << std::endl;
                 std::cout << "split:        " << layer.split << std::endl;
                 std::cout << "merge:        " << layer.merge << std::endl;
                 std::cout << "input:        " << layer.input << std::endl;
@@ -193,6 +254,14 @@ class Layers {
         Network &_network;
         std::string _jsonFolder;
         rapidjson::Document _layerJson;
+        unsigned long long _hash;
+        std::string _networkName;
+        std::string _inputImage;
+        std::string _verificationImage;
+        std::string _binparam;
+        bool _useBinparams;
+        unsigned int _binparamSkip;
+        unsigned int _layersSkip;
         unsigned int _outCh;
         unsigned int _outDim;
         unsigned int _outWords;
@@ -206,8 +275,17 @@ class Layers {
         unsigned int _maxSplit;
 
         std::vector<Layers::Layer> _layers;
+        std::vector<Layers::Step> _steps;
 
         void _parseLayers();
+        void _groupLayers();
+        void _weightMemory(Layers::Layer &);
+        void _activationMemory(Layers::Layer &);
+        void _buildSteps();
+        void _planSteps();
+        bool _sliceInput(unsigned int);
+        bool _sliceOutput(unsigned int);
+        void _loadPlan(std::vector<char> const &);
         bool _validateJson();
         bool _validateLayer(unsigned int);
 };
@@ -34,12 +34,36 @@
 #define debug 1
 #include "debug.h"
 
-Network::Network(std::vector<char> const &jsonContent) {
+Network::Network(std::vector<char> const &jsonContent) : _hash(GeneralUtils::hash(jsonContent)) {
     std::string jsonString(jsonContent.begin(), jsonContent.end());
     this->_networkJson.Parse(jsonString.c_str());
     if (!this->_validateJson()) {
         throw std::runtime_error("Network json is no compatible json file");
     }
+    // the parameters are constant, no json lookups after this point
+    rapidjson::Value const &parameters = this->_networkJson["parameters"];
+    this->_descriptor.maxK = parameters["MAX_K"].GetInt();
+    this->_descriptor.maxIFMCh = parameters["MAX_IFM_CH"].GetInt();
+    this->_descriptor.maxIFMDim = parameters["MAX_IFM_DIM"].GetInt();
+    this->_descriptor.maxOFMCh = parameters["MAX_OFM_CH"].GetInt();
+    this->_descriptor.maxOFMDim = parameters["MAX_OFM_DIM"].GetInt();
+    this->_descriptor.maxPoolSize = parameters["MAX_POOL_SIZE"].GetInt();
+    this->_descriptor.maxPoolStride = parameters["MAX_POOL_STRIDE"].GetInt();
+    this->_descriptor.maxSIMD = parameters["MAX_SIMD"].GetInt();
+    this->_descriptor.maxPEConv = parameters["MAX_PE_CONV"].GetInt();
+    this->_descriptor.maxPEFC = parameters["MAX_PE_FC"].GetInt();
+    this->_descriptor.memChannels = parameters["MEM_CHANNELS"].GetInt();
+    this->_descriptor.activationBits = parameters["ACTIVATION_BITS"].GetInt();
+    this->_descriptor.weightsBits = parameters["WEIGHTS_BITS"].GetInt();
+    this->_descriptor.treshholdsBits = parameters["THRESHOLDS_BITS"].GetInt();
+    this->_descriptor.maccBits = parameters["MACC_BITS"].GetInt();
+    this->_descriptor.datawidth = parameters["DATAWIDTH"].GetInt();
+    this->_descriptor.channelSlice = this->_getOptional("CHANNEL_SLICE", 0) != 0;
+    this->_descriptor.groupedConv = this->_getOptional("GROUPED_CONV", 0) != 0;
+    this->_descriptor.exactWeights = this->_getOptional("EXACT_WEIGHTS", 0) != 0;
+    this->_descriptor.compactActivations = this->_getOptional("COMPACT_ACTIVATIONS", 0) != 0;
+    this->_descriptor.batchOffload = this->_getOptional("BATCH_OFFLOAD", 0) != 0;
+    this->_descriptor.weightPrefetch = this->_getOptional("WEIGHT_PREFETCH", 0) != 0;
 }
 
 Network::Network(std::string const &jsonFilepath) : Network(GeneralUtils::readBinaryFile(jsonFilepath)) {}
@@ -73,70 +97,154 @@ bool Network::_validateJson() {
         this->_networkJson["parameters"]["WEIGHTS_BITS"].IsInt() &&
         this->_networkJson["parameters"]["THRESHOLDS_BITS"].IsInt() &&
         this->_networkJson["parameters"]["MACC_BITS"].IsInt() &&
-        this->_networkJson["parameters"]["DATAWIDTH"].IsInt();
+        this->_networkJson["parameters"]["DATAWIDTH"].IsInt() &&
+        this->_validateOptional("CHANNEL_SLICE") &&
+        this->_validateOptional("GROUPED_CONV") &&
+        this->_validateOptional("EXACT_WEIGHTS") &&
+        this->_validateOptional("COMPACT_ACTIVATIONS") &&
+        this->_validateOptional("BATCH_OFFLOAD") &&
+        this->_validateOptional("WEIGHT_PREFETCH");
     return result;
 }
 
+/**
+ * optional parameters describe hardware features newer bitstreams have,
+ * they are missing in older network jsons
+ * @param name parameter name
+ * @return true if the parameter is missing or an int
+ */
+bool Network::_validateOptional(char const *name) {
+    rapidjson::Value const &parameters = this->_networkJson["parameters"];
+    return !parameters.HasMember(name) || parameters[name].IsInt();
+}
+
+unsigned int Network::_getOptional(char const *name, unsigned int defaultValue) {
+    rapidjson::Value const &parameters = this->_networkJson["parameters"];
+    return parameters.HasMember(name) ? parameters[name].GetInt() : defaultValue;
+}
+
 unsigned int Network::getMaxK() {
-    return this->_networkJson["parameters"]["MAX_K"].GetInt();
+    return this->_descriptor.maxK;
 }
 
 unsigned int Network::getMaxIFMCh() {
-    return this->_networkJson["parameters"]["MAX_IFM_CH"].GetInt();
+    return this->_descriptor.maxIFMCh;
 }
 
 unsigned int Network::getMaxIFMDim() {
-    return this->_networkJson["parameters"]["MAX_IFM_DIM"].GetInt();
+    return this->_descriptor.maxIFMDim;
 }
 
 unsigned int Network::getMaxOFMCh() {
-    return this->_networkJson["parameters"]["MAX_OFM_CH"].GetInt();
+    return this->_descriptor.maxOFMCh;
 }
 
 unsigned int Network::getMaxOFMDim() {
-    return this->_networkJson["parameters"]["MAX_OFM_DIM"].GetInt();
+    return this->_descriptor.maxOFMDim;
 }
 
 unsigned int Network::getMaxPoolSize() {
-    return this->_networkJson["parameters"]["MAX_POOL_SIZE"].GetInt();
+    return this->_descriptor.maxPoolSize;
 }
 
 unsigned int Network::getMaxPoolStride() {
-    return this->_networkJson["parameters"]["MAX_POOL_STRIDE"].GetInt();
+    return this->_descriptor.maxPoolStride;
 }
 
 unsigned int Network::getMaxSIMD() {
-    return this->_networkJson["parameters"]["MAX_SIMD"].GetInt();
+    return this->_descriptor.maxSIMD;
 }
 
 unsigned int Network::getMaxPEConv() {
-    return this->_networkJson["parameters"]["MAX_PE_CONV"].GetInt();
+    return this->_descriptor.maxPEConv;
 }
 
 unsigned int Network::getMaxPEFC() {
-    return this->_networkJson["parameters"]["MAX_PE_FC"].GetInt();
+    return this->_descriptor.maxPEFC;
 }
 
 unsigned int Network::getMemChannels() {
-    return this->_networkJson["parameters"]["MEM_CHANNELS"].GetInt();
+    return this->_descriptor.memChannels;
 }
 
 unsigned int Network::getActivationBits() {
-    return this->_networkJson["parameters"]["ACTIVATION_BITS"].GetInt();
+    return this->_descriptor.activationBits;
 }
 
 unsigned int Network::getWeightsBits() {
-    return this->_networkJson["parameters"]["WEIGHTS_BITS"].GetInt();
+    return this->_descriptor.weightsBits;
 }
 
 unsigned int Network::getTreshholdsBits() {
-    return this->_networkJson["parameters"]["THRESHOLDS_BITS"].GetInt();
+    return this->_descriptor.treshholdsBits;
 }
 
 unsigned int Network::getMACCBits() {
-    return this->_networkJson["parameters"]["MACC_BITS"].GetInt();
+    return this->_descriptor.maccBits;
 }
 
 unsigned int Network::getDatawidth() {
-    return this->_networkJson["parameters"]["DATAWIDTH"].GetInt();
+    return this->_descriptor.datawidth;
+}
+
+/**
+ * @return true if the hardware reads and writes channel groups of shared
+ * buffers, so grouped layers need no host split and merge
+ */
+bool Network::hasChannelSlice() {
+    return this->_descriptor.channelSlice;
+}
+
+/**
+ * @return true if the matrix vector unit computes grouped convolutions, so
+ * a split, conv, merge sequence runs as one layer with one weight load
+ */
+bool Network::hasGroupedConv() {
+    return this->_descriptor.groupedConv;
+}
+
+/**
+ * @return true if the weight memory initialization streams only the
+ * weights and treshholds of the layer shape instead of the whole memory
+ */
+bool Network::hasExactWeights() {
+    return this->_descriptor.exactWeights;
+}
+
+/**
+ * @return true if the activation buffers hold only the channels of the
+ * layer rounded to whole memory words per pixel, instead of MAX_IFM_CH
+ */
+bool Network::hasCompactActivations() {
+    return this->_descriptor.compactActivations;
+}
+
+/**
+ * @return true if one accelerator invocation can compute a layer for a
+ * whole batch of images
+ */
+bool Network::hasBatchOffload() {
+    return this->_descriptor.batchOffload;
+}
+
+/**
+ * @return true if the accelerator has a second weight bank, which takes
+ * the weights of the next layer while the current layer computes
+ */
+bool Network::hasWeightPrefetch() {
+    return this->_descriptor.weightPrefetch;
+}
+
+/**
+ * @return all network parameters in one plain structure
+ */
+Network::Descriptor const &Network::getDescriptor() const {
+    return this->_descriptor;
+}
+
+/**
+ * @return hash of the network json content
+ */
+unsigned long long Network::getHash() {
+    return this->_hash;
 }
@@ -45,6 +45,36 @@
 
 class Network {
     public:
+        /**
+         * network parameters, filled once from the json, so hot paths can
+         * read them without json lookups
+         */
+        struct Descriptor {
+            unsigned int maxK;
+            unsigned int maxIFMCh;
+            unsigned int maxIFMDim;
+            unsigned int maxOFMCh;
+            unsigned int maxOFMDim;
+            unsigned int maxPoolSize;
+            unsigned int maxPoolStride;
+            unsigned int maxSIMD;
+            unsigned int maxPEConv;
+            unsigned int maxPEFC;
+            unsigned int memChannels;
+            unsigned int activationBits;
+            unsigned int weightsBits;
+            unsigned int treshholdsBits;
+            unsigned int maccBits;
+            unsigned int datawidth;
+            //optional hardware features, off if not in the json
+            bool channelSlice;
+            bool groupedConv;
+            bool exactWeights;
+            bool compactActivations;
+            bool batchOffload;
+            bool weightPrefetch;
+        };
+
         Network(std::vector<char> const &);
         Network(std::string const &);
         ~Network();
@@ -64,9 +94,21 @@ class Network {
         unsigned int getTreshholdsBits();
         unsigned int getMACCBits();
         unsigned int getDatawidth();
+        bool hasChannelSlice();
+        bool hasGroupedConv();
+        bool hasExactWeights();
+        bool hasCompactActivations();
+        bool hasBatchOffload();
+        bool hasWeightPrefetch();
+        unsigned long long getHash();
+        Descriptor const &getDescriptor() const;
     private:
         rapidjson::Document _networkJson;
+        Descriptor _descriptor;
+        unsigned long long _hash;
         void _parseLayers();
         bool _validateJson();
+        bool _validateOptional(char const *);
+        unsigned int _getOptional(char const *, unsigned int);
 };
 #endif
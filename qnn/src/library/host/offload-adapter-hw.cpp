@@ -60,11 +60,32 @@
 #endif
 #endif
 
+// only the ZYNQMP bitstreams are synthesized with the shadow weight bank
+#ifdef ZYNQMP
+#define HWWEIGHTBANKS 2
+#else
+#define HWWEIGHTBANKS 1
+#endif
+
+// weight buffer address registers, one per memory channel
+static unsigned int const weightRegisters[] = { 0x10, 0x1c };
+static unsigned int const weightRegisterCount = sizeof(weightRegisters) / sizeof(weightRegisters[0]);
+// address registers of the weights streaming into the shadow bank
+static unsigned int const prefetchRegisters[] = { 0xfc, 0x108 };
+
 std::list<OffloadAdapter *> OffloadAdapter::_instances(0);
 
+bool OffloadAdapter::configuresFabric() {
+    return true;
+}
+
 OffloadAdapter::OffloadAdapter(std::string const &platformName, unsigned int memoryChannels, size_t bufferSize) :
-    _running(false), _isHardware(true), _bufferSize(bufferSize), _weightBuffers(memoryChannels)   {
+    _running(false), _batchTable(NULL), _isHardware(true), _weightBanks(HWWEIGHTBANKS), _bufferSize(bufferSize), _localPages(LOCALBUFFER_PAGES_DEFAULT),
+    _weightLoading(WEIGHTS_LOADING_EAGER), _weightBudget(0), _weightResident(0), _weightActive(-1), _weightJobber(NULL), _weights(memoryChannels)   {
         assert(this->_bufferSize > 0);
+        if (memoryChannels > weightRegisterCount) {
+            throw std::runtime_error("Hardware supports only " + std::to_string(weightRegisterCount) + " memory channels!");
+        }
         this->_platform = (void *) new XlnkDriver(HWADDRESS, 64 * 1024);
         XlnkDriver *platform = (XlnkDriver *) this->_platform;
         platform->attach(platformName.c_str());
@@ -80,7 +101,10 @@ OffloadAdapter::~OffloadAdapter() {
     // debug_info("2\n");
     this->_localBuffers.clear();
     // debug_info("3\n");
-    this->_weightBuffers.clear();
+    this->_freeWeights();
+    if (this->_batchTable != NULL) {
+        this->free(this->_batchTable);
+    }
     // debug_info("end\n");
     delete platform;
 };
@@ -103,6 +127,11 @@ ExtMemWord * OffloadAdapter::malloc(unsigned int const byteSize) {
     return (ExtMemWord *) platform->getVirt(accelBuf);
 }
 
+unsigned long long OffloadAdapter::phys(ExtMemWord *buffer) {
+    XlnkDriver *platform = (XlnkDriver *) this->_platform;
+    return (unsigned long long) platform->getPhys((void *) buffer);
+}
+
 void OffloadAdapter::execAsync() {
     XlnkDriver *platform = (XlnkDriver *) this->_platform;
     platform->writeJamRegAddr(0x00, 1);
@@ -114,14 +143,9 @@ void OffloadAdapter::sync() {
         this->wait();
     }
     if (!this->_syncData.synced){
-        OffloadAdapter::ExtMemBuffer &inputBuffer = *this->_syncData.input;
-        OffloadAdapter::ExtMemBuffer &outputBuffer = *this->_syncData.output;
-        inputBuffer.lock.unlock();
-        outputBuffer.lock.unlock();
-        inputBuffer.cond.notify_all();
-        outputBuffer.cond.notify_all();
-        this->_syncData.synced = true;
+        this->_syncData.release();
     }
+    this->_syncWeightPrefetch();
 }
 
 void OffloadAdapter::wait() {
@@ -149,40 +173,63 @@ void OffloadAdapter::reset() {
 void OffloadAdapter::offloadWeights(Layers::Layer const &layer, unsigned int const weightOffset) {
     XlnkDriver *platform = (XlnkDriver *) this->_platform;
     this->_running = true;
-    //assert(this->memoryChannelCount() == 2);
-    OffloadAdapter::ExtMemBuffer &w1 = *std::next(this->_weightBuffers[0].begin(), layer.weightIndex + weightOffset);
-    OffloadAdapter::ExtMemBuffer &w2 = *std::next(this->_weightBuffers[1].begin(), layer.weightIndex + weightOffset);
+    if (this->_prefetching(layer.network.getDescriptor())) {
+        // prefetched weights are copied over from the shadow bank
+        bool const commit = this->_weightPrefetch.commit(layer.weightIndex + weightOffset);
+        platform->writeJamRegAddr(0xf4, commit);
+        //debug_register(0xf4, "Commit", commit);
+        if (commit) {
+            platform->writeJamRegAddr(0x34, true);
+            //debug_register(0x34, "doInit", true);
+            return;
+        }
+    }
+    WeightTable::Entry const *weights = this->_useWeights(layer.weightIndex + weightOffset);
     //debug_info("Loading weights for index %u\n", layer.weightIndex + weightOffset);
 
-    platform->write64BitJamRegAddr(0x10, (AccelDblReg) platform->getPhys((void *) w1.buffer));
-    //debug_register(0x10, "memBuf1", platform->getPhys((void *) w1.buffer));
-    platform->write64BitJamRegAddr(0x1c, (AccelDblReg) platform->getPhys((void *) w2.buffer));
-    //debug_register(0x1c, "memBuf2", platform->getPhys((void *) w2.buffer));
+    for (unsigned int c = 0; c < this->_weights.channels(); c++) {
+        platform->write64BitJamRegAddr(weightRegisters[c], (AccelDblReg) weights[c].phys);
+        //debug_register(weightRegisters[c], "memBuf", weights[c].phys);
+    }
     platform->writeJamRegAddr(0x34, true);
     //debug_register(0x34, "doInit", true);
     platform->writeJamRegAddr(0x3c, Layers::hw_conv);
     //debug_register(0x3c, "LayerType", CONV_LAYER);
     platform->writeJamRegAddr(0x44, layer.kernelDim);
     //debug_register(0x44, "ConvKernelDim", layer.kernelDim);
+    if (layer.network.getDescriptor().exactWeights) {
+        // the layer shape sizes the weight stream
+        platform->writeJamRegAddr(0x54, layer.IFMCh);
+        //debug_register(0x54, "IFMCh", layer.IFMCh);
+        platform->writeJamRegAddr(0x5c, layer.OFMCh);
+        //debug_register(0x5c, "OFMCh", layer.OFMCh);
+        platform->writeJamRegAddr(0xc0, layer.groups);
+        //debug_register(0xc0, "Groups", layer.groups);
+    } else {
+        // no channels stream the whole weight memory, the registers may
+        // still hold the shape of the last computed layer
+        platform->writeJamRegAddr(0x54, 0);
+        //debug_register(0x54, "IFMCh", 0);
+        platform->writeJamRegAddr(0x5c, 0);
+        //debug_register(0x5c, "OFMCh", 0);
+        platform->writeJamRegAddr(0xc0, 1);
+        //debug_register(0xc0, "Groups", 1);
+    }
 }
 
-void OffloadAdapter::offload(OffloadAdapter::ExtMemBuffer &inputBuffer, OffloadAdapter::ExtMemBuffer &outputBuffer, Layers::Layer const &layer) {
+void OffloadAdapter::offload(OffloadAdapter::BufferView const &inputBuffer, OffloadAdapter::BufferView const &outputBuffer, Layers::Layer const &layer, OffloadAdapter::ChannelSlice const &slice) {
     XlnkDriver *platform = (XlnkDriver *) this->_platform;
     this->_running = true;
-    this->_syncData.synced = false;
-    this->_syncData.input = &inputBuffer;
-    this->_syncData.output = &outputBuffer;
-    //Lock buffers, they can only be savely unlocked on the sync call
-    inputBuffer.lock.lock();
-    outputBuffer.lock.lock();
+    //Lock and reference buffers, they are released on the sync call
+    this->_syncData.acquire(inputBuffer, outputBuffer);
     //inputBuffer.flush();
     // enable compute mode
     platform->writeJamRegAddr(0x34, false);
     //debug_register(0x34, "doInit", false);
 
-    platform->write64BitJamRegAddr(0x10, (AccelDblReg) platform->getPhys((void *) inputBuffer.buffer));
+    platform->write64BitJamRegAddr(0x10, (AccelDblReg) platform->getPhys((void *) inputBuffer->buffer));
     //debug_register(0x10, "accelBufIn", platform->getPhys((void *) inputBuffer));
-    platform->write64BitJamRegAddr(0x28, (AccelDblReg) platform->getPhys((void *) outputBuffer.buffer) );
+    platform->write64BitJamRegAddr(0x28, (AccelDblReg) platform->getPhys((void *) outputBuffer->buffer) );
     //debug_register(0x28, "accelBufOut",  platform->getPhys((void *) outputBuffer));
 
 
@@ -208,4 +255,75 @@ void OffloadAdapter::offload(OffloadAdapter::ExtMemBuffer &inputBuffer, OffloadA
     //debug_register(0x84, "PoolOutDim", layer.poolOutDim);
     platform->writeJamRegAddr(0x8c, layer.poolStride);
     //debug_register(0x8c, "PoolStride", layer.poolStride);
+    if (layer.network.getDescriptor().channelSlice) {
+        platform->writeJamRegAddr(0x94, slice.inOffset);
+        //debug_register(0x94, "InChOffset", slice.inOffset);
+        platform->writeJamRegAddr(0x9c, slice.outOffset);
+        //debug_register(0x9c, "OutChOffset", slice.outOffset);
+        platform->writeJamRegAddr(0xa4, slice.sliceIn);
+        //debug_register(0xa4, "SliceIn", slice.sliceIn);
+        platform->writeJamRegAddr(0xac, slice.sliceOut);
+        //debug_register(0xac, "SliceOut", slice.sliceOut);
+        // the other channel groups are read back from the output buffer
+        platform->write64BitJamRegAddr(0xb4, (AccelDblReg) platform->getPhys((void *) outputBuffer->buffer));
+        //debug_register(0xb4, "accelBufPrev", platform->getPhys((void *) outputBuffer));
+    }
+    platform->writeJamRegAddr(0xc0, layer.groups);
+    //debug_register(0xc0, "Groups", layer.groups);
+    if (layer.network.getDescriptor().compactActivations) {
+        unsigned int const wordBytes = layer.network.getDescriptor().datawidth / 8;
+        platform->writeJamRegAddr(0xc8, slice.getInStride(layer) / wordBytes);
+        //debug_register(0xc8, "InWords", slice.getInStride(layer) / wordBytes);
+        platform->writeJamRegAddr(0xd0, slice.getOutStride(layer) / wordBytes);
+        //debug_register(0xd0, "OutWords", slice.getOutStride(layer) / wordBytes);
+    }
+    if (layer.network.getDescriptor().batchOffload) {
+        platform->writeJamRegAddr(0xd8, 0);
+        //debug_register(0xd8, "NumImages", 0);
+    }
+    if (this->_prefetching(layer.network.getDescriptor())) {
+        bool const prefetch = this->_weightPrefetch.requested();
+        platform->writeJamRegAddr(0xec, prefetch);
+        //debug_register(0xec, "Prefetch", prefetch);
+        if (prefetch) {
+            for (unsigned int c = 0; c < this->_weights.channels(); c++) {
+                platform->write64BitJamRegAddr(prefetchRegisters[c], (AccelDblReg) this->_weightPrefetch.entries[c].phys);
+                //debug_register(prefetchRegisters[c], "nextBuf", this->_weightPrefetch.entries[c].phys);
+            }
+            platform->writeJamRegAddr(0x114, this->_weightPrefetch.layer->kernelDim);
+            //debug_register(0x114, "NextKernelDim", this->_weightPrefetch.layer->kernelDim);
+            platform->writeJamRegAddr(0x11c, this->_weightPrefetch.IFMCh());
+            //debug_register(0x11c, "NextIFMCh", this->_weightPrefetch.IFMCh());
+            platform->writeJamRegAddr(0x124, this->_weightPrefetch.OFMCh());
+            //debug_register(0x124, "NextOFMCh", this->_weightPrefetch.OFMCh());
+            platform->writeJamRegAddr(0x12c, this->_weightPrefetch.groups());
+            //debug_register(0x12c, "NextGroups", this->_weightPrefetch.groups());
+            this->_weightPrefetch.start();
+        }
+    }
+}
+
+/**
+ * programs one invocation computing the layer for all images, the registers
+ * are set up for the first image and the batch table tells the hardware
+ * where the buffers of the other images are
+ * @param inputBuffers  input buffer per image
+ * @param outputBuffers output buffer per image
+ * @param layer         layer to compute
+ * @param slice         channel slice, the same for all images
+ */
+void OffloadAdapter::offload(std::vector<OffloadAdapter::BufferView> const &inputBuffers, std::vector<OffloadAdapter::BufferView> const &outputBuffers, Layers::Layer const &layer, OffloadAdapter::ChannelSlice const &slice) {
+    XlnkDriver *platform = (XlnkDriver *) this->_platform;
+    if (!layer.network.getDescriptor().batchOffload) {
+        throw std::runtime_error("Hardware does not support batched offloads");
+    }
+    this->_fillBatchTable(inputBuffers, outputBuffers);
+    this->offload(inputBuffers[0], outputBuffers[0], layer, slice);
+    for (unsigned int i = 1; i < inputBuffers.size(); i++) {
+        this->_syncData.acquire(inputBuffers[i], outputBuffers[i]);
+    }
+    platform->writeJamRegAddr(0xd8, inputBuffers.size());
+    //debug_register(0xd8, "NumImages", inputBuffers.size());
+    platform->write64BitJamRegAddr(0xe0, (AccelDblReg) platform->getPhys((void *) this->_batchTable));
+    //debug_register(0xe0, "accelBufBatch", platform->getPhys((void *) this->_batchTable));
 }
@@ -38,6 +38,9 @@
 
 void WhiteBoxJam(ap_uint<64> * in, ap_uint<64> * out);
 
+// weight banks the top function was compiled with
+unsigned int WeightBanks();
+
 // DoReFa-Net top function
 void BlackBoxJam(ap_uint<64> * in1, ap_uint<64> * in2, ap_uint<64> * out,
         bool doInit, unsigned int layerType,
@@ -45,7 +48,15 @@ void BlackBoxJam(ap_uint<64> * in1, ap_uint<64> * in2, ap_uint<64> * out,
         const unsigned int IFMCh, const unsigned int OFMCh,
         const unsigned int IFMDim, const unsigned int PaddedDim,
         const unsigned int OFMDim, const unsigned int PoolInDim,
-        const unsigned int PoolOutDim, const unsigned int PoolStride);
+        const unsigned int PoolOutDim, const unsigned int PoolStride,
+        const unsigned int InChOffset, const unsigned int OutChOffset,
+        bool SliceIn, bool SliceOut, ap_uint<64> * prev,
+        const unsigned int Groups, const unsigned int InWords,
+        const unsigned int OutWords, const unsigned int NumImages,
+        ap_uint<64> * batch, bool Prefetch, bool Commit,
+        ap_uint<64> * next1, ap_uint<64> * next2,
+        const unsigned int NextKernelDim, const unsigned int NextIFMCh,
+        const unsigned int NextOFMCh, const unsigned int NextGroups);
 
 // CONV and FC top function
 void BlackBoxJamFC(ap_uint<64> * in, ap_uint<64> * out,
@@ -64,8 +75,16 @@ void BlackBoxJam(ap_uint<64> * in1, ap_uint<64> * in2, ap_uint<64> * out,
 
 std::list<OffloadAdapter *> OffloadAdapter::_instances(0);
 
+bool OffloadAdapter::configuresFabric() {
+    return false;
+}
+
 OffloadAdapter::OffloadAdapter(std::string const &platformName, unsigned int memoryChannel, size_t bufferSize) :
-    _running(false), _isHardware(false), _bufferSize(bufferSize), _weightBuffers(memoryChannel) {
+    _running(false), _batchTable(NULL), _isHardware(false), _weightBanks(WeightBanks()), _bufferSize(bufferSize), _localPages(LOCALBUFFER_PAGES_DEFAULT),
+    _weightLoading(WEIGHTS_LOADING_EAGER), _weightBudget(0), _weightResident(0), _weightActive(-1), _weightJobber(NULL), _weights(memoryChannel) {
+        if (memoryChannel != 2) {
+            throw std::runtime_error("Software implementation supports exactly 2 memory channels!");
+        }
         OffloadAdapter::_instances.push_back(this);
 };
 
@@ -73,7 +92,10 @@ OffloadAdapter::~OffloadAdapter() {
     OffloadAdapter::_instances.remove(this);
     this->_buffers.clear();
     this->_localBuffers.clear();
-    this->_weightBuffers.clear();
+    this->_freeWeights();
+    if (this->_batchTable != NULL) {
+        this->free(this->_batchTable);
+    }
 };
 
 void OffloadAdapter::free(ExtMemWord *buffer) {
@@ -88,20 +110,19 @@ ExtMemWord *OffloadAdapter::malloc(unsigned int const byteSize) {
     return buf;
 }
 
+unsigned long long OffloadAdapter::phys(ExtMemWord *buffer) {
+    return (unsigned long long) buffer;
+}
+
 bool OffloadAdapter::running() {
     return this->_running;
 }
 
 void OffloadAdapter::sync() {
     if (!this->_syncData.synced) {
-        OffloadAdapter::ExtMemBuffer &inputBuffer = *this->_syncData.input;
-        OffloadAdapter::ExtMemBuffer &outputBuffer = *this->_syncData.output;
-        inputBuffer.lock.unlock();
-        outputBuffer.lock.unlock();
-        inputBuffer.cond.notify_all();
-        outputBuffer.cond.notify_all();
-        this->_syncData.synced = true;
+        this->_syncData.release();
     }
+    this->_syncWeightPrefetch();
 }
 
 void OffloadAdapter::wait() {}
@@ -110,21 +131,72 @@ void OffloadAdapter::execAsync() {}
 
 void OffloadAdapter::offloadWeights(Layers::Layer const &layer, unsigned int weightOffset) {
     this->_running = true;
-    OffloadAdapter::ExtMemBuffer &w1 = *std::next(this->_weightBuffers[0].begin(), layer.weightIndex + weightOffset);
-    OffloadAdapter::ExtMemBuffer &w2 = *std::next(this->_weightBuffers[1].begin(), layer.weightIndex + weightOffset);
-    BlackBoxJam((ap_uint<64> *) w1.buffer, (ap_uint<64> *) w2.buffer,
-        NULL, true,  Layers::hw_conv, layer.kernelDim, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    // prefetched weights are copied over from the shadow bank
+    if (this->_prefetching(layer.network.getDescriptor()) && this->_weightPrefetch.commit(layer.weightIndex + weightOffset)) {
+        BlackBoxJam(NULL, NULL, NULL, true, Layers::hw_conv, layer.kernelDim, 0, 0, 0,
+            0, 0, 0, 0, 0, 0, 0, 0, false, false, NULL, 1, 0, 0, 0, NULL,
+            false, true, NULL, NULL, 0, 0, 0, 1);
+        this->_running = false;
+        return;
+    }
+    WeightTable::Entry const *weights = this->_useWeights(layer.weightIndex + weightOffset);
+    // no channels stream the whole weight memory
+    bool const exact = layer.network.getDescriptor().exactWeights;
+    BlackBoxJam((ap_uint<64> *) weights[0].buffer, (ap_uint<64> *) weights[1].buffer,
+        NULL, true,  Layers::hw_conv, layer.kernelDim, 0, exact ? layer.IFMCh : 0, exact ? layer.OFMCh : 0,
+        0, 0, 0, 0, 0, 0, 0, 0, false, false, NULL, exact ? layer.groups : 1, 0, 0, 0, NULL,
+        false, false, NULL, NULL, 0, 0, 0, 1);
     this->_running = false;
 }
 
 
-void OffloadAdapter::offload(OffloadAdapter::ExtMemBuffer &inputBuffer, OffloadAdapter::ExtMemBuffer &outputBuffer, Layers::Layer const &layer) {
+void OffloadAdapter::offload(OffloadAdapter::BufferView const &inputBuffer, OffloadAdapter::BufferView const &outputBuffer, Layers::Layer const &layer, OffloadAdapter::ChannelSlice const &slice) {
+    Network::Descriptor const &network = layer.network.getDescriptor();
+    bool const compact = network.compactActivations;
+    unsigned int const wordBytes = network.datawidth / 8;
+    bool const prefetch = this->_prefetching(network) && this->_weightPrefetch.requested();
+    this->_running = true;
+    this->_syncData.acquire(inputBuffer, outputBuffer);
+    BlackBoxJam((ap_uint<64> *) inputBuffer->buffer, NULL, (ap_uint<64> *) outputBuffer->buffer, false,
+        layer.type, layer.kernelDim, layer.log2stride, layer.IFMCh, layer.OFMCh, layer.IFMDim,
+        layer.paddedDim, layer.OFMDim, layer.poolInDim, layer.poolOutDim, layer.poolStride,
+        slice.inOffset, slice.outOffset, slice.sliceIn, slice.sliceOut, (ap_uint<64> *) outputBuffer->buffer,
+        layer.groups, compact ? slice.getInStride(layer) / wordBytes : 0, compact ? slice.getOutStride(layer) / wordBytes : 0,
+        0, NULL, prefetch, false, prefetch ? (ap_uint<64> *) this->_weightPrefetch.entries[0].buffer : NULL,
+        prefetch ? (ap_uint<64> *) this->_weightPrefetch.entries[1].buffer : NULL,
+        prefetch ? this->_weightPrefetch.layer->kernelDim : 0, prefetch ? this->_weightPrefetch.IFMCh() : 0,
+        prefetch ? this->_weightPrefetch.OFMCh() : 0, prefetch ? this->_weightPrefetch.groups() : 1);
+    if (prefetch) {
+        this->_weightPrefetch.start();
+    }
+    this->_running = false;
+}
+
+void OffloadAdapter::offload(std::vector<OffloadAdapter::BufferView> const &inputBuffers, std::vector<OffloadAdapter::BufferView> const &outputBuffers, Layers::Layer const &layer, OffloadAdapter::ChannelSlice const &slice) {
+    Network::Descriptor const &network = layer.network.getDescriptor();
+    bool const compact = network.compactActivations;
+    unsigned int const wordBytes = network.datawidth / 8;
+    bool const prefetch = this->_prefetching(network) && this->_weightPrefetch.requested();
+    if (!network.batchOffload) {
+        throw std::runtime_error("Hardware does not support batched offloads");
+    }
+    this->_fillBatchTable(inputBuffers, outputBuffers);
     this->_running = true;
-    this->_syncData.synced = false;
-    this->_syncData.input = &inputBuffer;
-    this->_syncData.output = &outputBuffer;
-    BlackBoxJam((ap_uint<64> *) inputBuffer.buffer, NULL, (ap_uint<64> *) outputBuffer.buffer, false,
+    for (unsigned int i = 0; i < inputBuffers.size(); i++) {
+        this->_syncData.acquire(inputBuffers[i], outputBuffers[i]);
+    }
+    BlackBoxJam((ap_uint<64> *) inputBuffers[0]->buffer, NULL, (ap_uint<64> *) outputBuffers[0]->buffer, false,
         layer.type, layer.kernelDim, layer.log2stride, layer.IFMCh, layer.OFMCh, layer.IFMDim,
-        layer.paddedDim, layer.OFMDim, layer.poolInDim, layer.poolOutDim, layer.poolStride);
+        layer.paddedDim, layer.OFMDim, layer.poolInDim, layer.poolOutDim, layer.poolStride,
+        slice.inOffset, slice.outOffset, slice.sliceIn, slice.sliceOut, (ap_uint<64> *) outputBuffers[0]->buffer,
+        layer.groups, compact ? slice.getInStride(layer) / wordBytes : 0, compact ? slice.getOutStride(layer) / wordBytes : 0,
+        inputBuffers.size(), (ap_uint<64> *) this->_batchTable, prefetch, false,
+        prefetch ? (ap_uint<64> *) this->_weightPrefetch.entries[0].buffer : NULL,
+        prefetch ? (ap_uint<64> *) this->_weightPrefetch.entries[1].buffer : NULL,
+        prefetch ? this->_weightPrefetch.layer->kernelDim : 0, prefetch ? this->_weightPrefetch.IFMCh() : 0,
+        prefetch ? this->_weightPrefetch.OFMCh() : 0, prefetch ? this->_weightPrefetch.groups() : 1);
+    if (prefetch) {
+        this->_weightPrefetch.start();
+    }
     this->_running = false;
 }
@@ -44,9 +44,17 @@
 #include <chrono>
 #include <condition_variable>
 #include <algorithm>
+#include <exception>
+#include <sstream>
+#include <cstdio>
+#include <sys/mman.h>
+#include "general-utils.h"
 #include "network.h"
 #include "layers.h"
 #include "platform.h"
+#include "weight-table.h"
+#include "weight-pack.h"
+#include "jobber.h"
 
 #define DEBUG 1
 #include "debug.h"
@@ -55,43 +63,117 @@
 #define EXTMEMBUFFER_LOCAL          true
 #define EXTMEMBUFFER_MAX_BUFFERS    100
 
+// images of one batched offload, bounded by the batch table
+#define OFFLOAD_MAX_IMAGES          64
+
+// backing pages of the local buffers
+#define LOCALBUFFER_PAGES_DEFAULT       0
+#define LOCALBUFFER_PAGES_TRANSPARENT   1
+#define LOCALBUFFER_PAGES_EXPLICIT      2
+
+// when the weights of the layers are loaded
+#define WEIGHTS_LOADING_EAGER           0
+#define WEIGHTS_LOADING_LAZY            1
+#define WEIGHTS_LOADING_PREFETCH        2
+
+// state of a weight table row
+#define WEIGHTS_UNLOADED                0
+#define WEIGHTS_LOADING                 1
+#define WEIGHTS_LOADED                  2
+
 class OffloadAdapter {
     public:
+        struct ExtMemBuffer;
+
+        /**
+         * returns a buffer to the pool of its adapter once the owner goes
+         */
+        struct BufferReleaser {
+            void operator()(ExtMemBuffer *buf) const;
+        };
+
+        // move-only owner of a pool buffer, returned to the pool on destruction
+        typedef std::unique_ptr<ExtMemBuffer, BufferReleaser> BufferHandle;
+        // shared ownership view of a pool buffer, returned with its last view
+        typedef std::shared_ptr<ExtMemBuffer> BufferView;
+        // marks a buffer as being written until the last copy is destroyed
+        typedef std::shared_ptr<void> Pending;
+        // fills a prepared weight block (file index, memory channel, target, size)
+        typedef std::function<void(unsigned int, unsigned int, ExtMemWord *, size_t)> WeightReader;
+
+        /**
+         * channel group of a grouped layer, read from a shared input buffer
+         * and written into a shared output buffer by hardware built with
+         * CHANNEL_SLICE
+         */
+        struct ChannelSlice {
+            ChannelSlice() : sliceIn(false), sliceOut(false), inOffset(0), outOffset(0), inStride(0), outStride(0) {};
+            //read the input channels from inOffset on
+            bool sliceIn;
+            //write the output channels to outOffset, keep all others
+            bool sliceOut;
+            unsigned int inOffset;
+            unsigned int outOffset;
+            //bytes per pixel of the sliced buffers, 0 keeps the layer strides
+            unsigned int inStride;
+            unsigned int outStride;
+
+            unsigned int getInStride(Layers::Layer const &layer) const {
+                return (this->inStride != 0) ? this->inStride : layer.inStride;
+            }
+
+            unsigned int getOutStride(Layers::Layer const &layer) const {
+                return (this->outStride != 0) ? this->outStride : layer.outStride;
+            }
+        };
+
         struct ExtMemBuffer {
             private:
+                friend struct OffloadAdapter::BufferReleaser;
                 OffloadAdapter *_parent;
                 bool _local;
+                size_t _mapped;
                 std::atomic<unsigned int> _pending;
+
+                void _release() {
+                    this->_pending = 0;
+                    this->_parent->releaseBuffer(*this);
+                }
+
+                void _done() {
+                    std::unique_lock<std::mutex> lk(this->lock);
+                    if (this->_pending > 0) {
+                        this->_pending--;
+                    }
+                    lk.unlock();
+                    this->cond.notify_all();
+                }
             public:
                 ExtMemWord *buffer;
                 std::mutex lock;
                 std::condition_variable cond;
 
-                ExtMemBuffer(OffloadAdapter *parent, ExtMemWord *const  buf, bool local = false)
-                 : _parent(parent), _local(local), _pending(0), buffer(buf) {}
+                ExtMemBuffer(OffloadAdapter *parent, ExtMemWord *const  buf, bool local = false, size_t mapped = 0)
+                 : _parent(parent), _local(local), _mapped(mapped), _pending(0), buffer(buf) {}
 
                 ~ExtMemBuffer() {
                     if (this->_local) {
-                        delete [] this->buffer;
+                        this->_parent->_localFree(this->buffer, this->_mapped);
                     } else {
                         this->_parent->free(this->buffer);
                     }
                 }
 
-                void release() {
-                    this->_pending = 0;
-                    this->_parent->releaseBuffer(*this);
-                }
-
-                void setTarget(unsigned int t) {
-                    this->_pending = t;
-                }
-
-                bool down() {
-                    if (this->_pending > 0) {
-                        this->_pending--;
-                    }
-                    return this->_pending == 0;
+                /**
+                 * Marks the buffer as pending until every copy of the
+                 * returned token is destroyed. Jobs writing the buffer
+                 * capture the token, waitPending returns when all of them
+                 * are gone.
+                 * @return pending token
+                 */
+                Pending pend() {
+                    this->_pending++;
+                    return Pending((void *) this, [this](void *) { this->_done(); });
                 }
 
                 void wait() {
@@ -127,13 +209,41 @@ class OffloadAdapter {
         ~OffloadAdapter();
 
         void offloadWeights(Layers::Layer const &, unsigned int const=0);
-        void offload(ExtMemBuffer &, ExtMemBuffer &, Layers::Layer const &);
+
+        /**
+         * streams the weights of a layer into the shadow weight bank along
+         * the next offload, a later offloadWeights of the same weights only
+         * commits the shadow bank. Does nothing on hardware with one bank
+         * @param layer        layer the weights belong to
+         * @param weightOffset iteration or split offset of the weights
+         */
+        void prefetchWeights(Layers::Layer const &layer, unsigned int const weightOffset = 0) {
+            if (!this->_prefetching(layer.network.getDescriptor())) {
+                return;
+            }
+            unsigned int const index = layer.weightIndex + weightOffset;
+            if (this->_weightPrefetch.holds(index)) {
+                return;
+            }
+            // the row stays pinned until the hardware streamed it
+            WeightTable::Entry const *entries = this->_pinWeights(index);
+            if (this->_weightPrefetch.requested()) {
+                this->_unpinWeights(this->_weightPrefetch.index);
+            }
+            this->_weightPrefetch.entries = entries;
+            this->_weightPrefetch.layer = &layer;
+            this->_weightPrefetch.index = index;
+        }
+        void offload(BufferView const &, BufferView const &, Layers::Layer const &, ChannelSlice const & = ChannelSlice());
+        void offload(std::vector<BufferView> const &, std::vector<BufferView> const &, Layers::Layer const &, ChannelSlice const & = ChannelSlice());
 
         unsigned int reserveBuffers(unsigned int num = 1, bool local = false) {
             for (unsigned int i = 0; i < num; i++) {
                 try {
                     if (local) {
-                        this->_localBuffers.emplace_back(this, new ExtMemWord[this->_bufferSize / sizeof(ExtMemWord)], true);
+                        size_t mapped = 0;
+                        ExtMemWord *buffer = this->_localMalloc(mapped);
+                        this->_localBuffers.emplace_back(this, buffer, true, mapped);
                         this->_localUnusedBuffers.emplace_back(&this->_localBuffers.back());
                     } else {
                         this->_buffers.emplace_back(this, this->malloc(this->_bufferSize));
@@ -146,9 +256,16 @@ class OffloadAdapter {
             return num;
         }
 
-        OffloadAdapter::ExtMemBuffer &getBuffer(bool local = false) {
+        /**
+         * takes a buffer from the pool, a new one is reserved if the pool is
+         * empty. If that fails too, it waits until a handle returns its
+         * buffer to the pool
+         * @param  local local or hardware buffer
+         * @return       owning handle of the buffer
+         */
+        OffloadAdapter::BufferHandle getBuffer(bool local = false) {
             std::unique_lock<std::mutex> locker(this->_bufferLock);
-            bool done = this->_bufferCondition.wait_until(locker, std::chrono::system_clock::now() + std::chrono::seconds(5), [this, local](){
+            this->_bufferCondition.wait(locker, [this, local](){
                             bool result = (local  && this->_localUnusedBuffers.size() > 0) || (!local && this->_unusedBuffers.size() > 0);
                             if (!result) {
                                 return this->reserveBuffers(1, local) == 1;
@@ -156,9 +273,6 @@ class OffloadAdapter {
                                 return true;
                             }
                         });
-            if (!done) {
-                throw std::runtime_error("Timeout waiting for a buffer releases!");
-            }
             OffloadAdapter::ExtMemBuffer *buf;
             if (local) {
                 buf = this->_localUnusedBuffers.back();
@@ -167,7 +281,7 @@ class OffloadAdapter {
                 buf = this->_unusedBuffers.back();
                 this->_unusedBuffers.pop_back();
             }
-            return *buf;
+            return OffloadAdapter::BufferHandle(buf);
         }
 
         // void flushBuffer(OffloadAdapter::ExtMemBuffer &buf) {
@@ -201,10 +315,66 @@ class OffloadAdapter {
             return this->_bufferSize;
         }
 
+        /**
+         * selects the pages backing local buffers reserved from now on
+         * @param pages LOCALBUFFER_PAGES_DEFAULT, LOCALBUFFER_PAGES_TRANSPARENT
+         *              or LOCALBUFFER_PAGES_EXPLICIT
+         */
+        void setLocalPages(unsigned int pages) {
+            this->_localPages = pages;
+        }
+
+        /**
+         * selects when the weights are loaded, has to be set before
+         * loadWeights. Eager loads all weights up front, lazy loads the
+         * weights of a layer on its first use and prefetch additionally
+         * loads the next weight index on the jobber while the current one
+         * computes
+         * @param loading WEIGHTS_LOADING_EAGER, WEIGHTS_LOADING_LAZY or
+         *                WEIGHTS_LOADING_PREFETCH
+         * @param budget  bytes of resident weights before the least recently
+         *                used weights are evicted, 0 for no limit. Weights
+         *                still in use by the hardware are never evicted
+         */
+        void setWeightLoading(unsigned int loading, size_t budget = 0) {
+            this->_weightLoading = loading;
+            this->_weightBudget = budget;
+        }
+
+        /**
+         * sets a reader providing the prepared weight blocks, for example
+         * from a zip package. The reader is called in parallel for
+         * different blocks and replaces binparam files, weight packs and
+         * the weight cache
+         * @param reader weight block reader, empty to read binparams again
+         */
+        void setWeightReader(OffloadAdapter::WeightReader const &reader) {
+            this->_weightReader = reader;
+        }
+
+        /**
+         * sets the directory prepared weight images are cached in, an
+         * empty path disables the cache
+         * @param path cache directory
+         */
+        void setWeightCache(std::string const &path) {
+            this->_weightCache = path;
+        }
+
         void reset();
 
         void free(ExtMemWord *buffer);
         ExtMemWord *malloc(unsigned int const);
+        unsigned long long phys(ExtMemWord *buffer);
+
+        /**
+         * gives access to the loaded weight buffers and their physical
+         * addresses, indexed by layer.weightIndex + offset
+         * @return the weight table
+         */
+        WeightTable const &getWeightTable() {
+            return this->_weights;
+        }
 
         /**
          * to detect from main application if we are in hardware or not
@@ -214,80 +384,153 @@ class OffloadAdapter {
             return this->_isHardware;
         }
 
+        /**
+         * tells before any adapter exists if a bitstream has to be
+         * configured, the software build has no fabric
+         * @return true if hardware, false else
+         */
+        static bool configuresFabric();
+
         /**
          * Loads the weight and treshhold files for the given layers. Does the same for
          * HW and SW no need to differentiate here has some private helper function
-         * just for nice code
+         * just for nice code. If the binparam path is a weight pack, every block
+         * is copied from the mapped pack instead, a weight reader takes
+         * precedence over both. With a weight cache
+         * directory set, the prepared blocks are read from a cached pack of
+         * the same network, layers and binparams or written to it after the
+         * first load. Grouped layers fill one block from the files of all
+         * groups.
+         * First every block gets its weight index and file index assigned.
+         * Eager loading then fills all blocks in parallel on the jobber, the
+         * calling thread helps working off the jobs. Lazy and prefetch
+         * loading only keep the plan, rows are loaded by offloadWeights and
+         * no cache is written.
          * ! split layers with multiple iterations not supported !
+         * @param network  reference to the Network Class object
          * @param layers   reference to the Layers Class object with alle the layer informations
-         * @param dataRoot path to the data root where the weights are
+         * @param jobber   pool the blocks are filled and prefetched on
          */
-        void loadWeights(Network &network, Layers &layers) {
+        void loadWeights(Network &network, Layers &layers, Jobber &jobber) {
             if (layers.useBinparams()) {
-                unsigned int const maxSIMD = network.getMaxSIMD();
-                unsigned int const maxPEConv = network.getMaxPEConv();
-                unsigned int const maxPeIndex = (unsigned int) std::floor(maxPEConv / this->_weightBuffers.size());
+                unsigned int const memoryChannels = this->_weights.channels();
                 unsigned int weightFileIndex = layers.getBinparamSkip();
                 unsigned int multiple = 1;
-                std::string const dataRoot = layers.getBinparamPath();
-                bool split = false;
-                for (auto const &layer : layers) {
-                    if (layer.layer & Layers::split) {
-                        multiple = layer.split;
-                        split = true;
-                    } else if(layer.layer & Layers::merge) {
-                        multiple = 1;
-                        split = false;
-                    } else if (layer.layer & Layers::conv) {
-                        if (split) {
-                            if (layer.iterations > 1) {
-                                std::cerr << "Current implementation doesn't allow multi iteration layers in split mode!" << std::endl;
-                                throw std::runtime_error("Multi iteration layer embedded in split mode!");
+                bool const reader = (bool) this->_weightReader;
+                if (!reader) {
+                    this->_weightRoot = layers.getBinparamPath();
+                }
+                this->_weightJobber = &jobber;
+                std::unique_ptr<WeightPack> &pack = this->_weightPack;
+                std::string cachePath;
+                unsigned long long cacheKey = 0;
+                if (this->_weightCache.size() > 0 && !reader) {
+                    unsigned long long const hashes[] = { network.getHash(), layers.getHash(), layers.getBinparamHash() };
+                    cacheKey = GeneralUtils::hash((char const *) hashes, sizeof(hashes));
+                    std::ostringstream name;
+                    name << this->_weightCache << "/" << layers.getNetwork() << "-" << std::hex << cacheKey << ".qnnw";
+                    cachePath = name.str();
+                    if (GeneralUtils::fileExists(cachePath)) {
+                        // a truncated or outdated cache is dropped and written again
+                        try {
+                            pack.reset(new WeightPack(cachePath));
+                            if (pack->key() != cacheKey || pack->channels() != memoryChannels) {
+                                pack.reset();
                             }
-                        } else {
-                            multiple = layer.iterations;
+                        } catch (std::exception const &e) {
+                            pack.reset();
+                            std::remove(cachePath.c_str());
+                            std::cerr << "Ignoring weight cache " << cachePath << ": " << e.what() << std::endl;
                         }
-                        unsigned long treshholdOffset = maxPeIndex * layer.convWMem;
-                        for (unsigned int i = 0; i < multiple; i++) { //for splits or multi iteration layers
-                            for (unsigned int memoryChannel = 0; memoryChannel < this->_weightBuffers.size(); memoryChannel++) { //for every memory channel
-                                ExtMemWord *work = this->malloc(layer.convMem);
-                                if(!work) {
-                                    throw std::runtime_error("Could not allocate contiguous memory!");
-                                }
-                                try {
-                                    for (unsigned int peIndex = 0; peIndex < maxPeIndex; peIndex++) { // for every weight file
-                                        // debug_info("Load file %s\n", std::string(dataRoot + "/" + std::to_string(weightFileIndex) + "-" + std::to_string(peIndex + (memoryChannel * maxPeIndex)) + "-weights.bin").c_str());
-                                        std::string weightFilename(dataRoot + "/" + std::to_string(weightFileIndex) + "-" + std::to_string(peIndex + (memoryChannel * maxPeIndex)) + "-weights.bin");
-                                        // debug_info("Load file %s\n", std::string(dataRoot + "/" + std::to_string(weightFileIndex) + "-" + std::to_string(peIndex + (memoryChannel * maxPeIndex)) + "-thres.bin").c_str());
-                                        std::string treshholdFilename(dataRoot + "/" + std::to_string(weightFileIndex) + "-" + std::to_string(peIndex + (memoryChannel * maxPeIndex)) + "-thres.bin");
-                                        std::ifstream weightFile(weightFilename, std::ios::binary | std::ios::in);
-                                        if (!weightFile.is_open()) {
-                                            throw std::runtime_error("Could not open " + weightFilename);
-                                        }
-                                        std::ifstream treshholdFile(treshholdFilename, std::ios::binary | std::ios::in);
-                                        if (!treshholdFile.is_open()) {
-                                            throw std::runtime_error("Could not open " + treshholdFilename);
-                                        }
-                                        if (weightFileIndex == 0 && (layer.IFMCh * layer.stride) < maxSIMD) {
-                                            this->_loadFirstLayerWeights(work, 0, peIndex, weightFile, layer);
-                                        } else {
-                                            this->_loadLayerWeights(work, 0, peIndex, weightFile, layer);
-                                        }
-                                        this->_loadLayerTreshholds(work, treshholdOffset, peIndex, treshholdFile, layer);
-                                        weightFile.close();
-                                        treshholdFile.close();
-                                    } //for each PEIndex
-                                } catch(...) {
-                                    this->free(work);
-                                    throw;
+                    }
+                }
+                bool const cached = (bool) pack;
+                if (!reader && !pack && layers.useBinparamPack()) {
+                    pack.reset(new WeightPack(layers.getBinparamPackPath()));
+                    if (pack->channels() != memoryChannels) {
+                        throw std::runtime_error("Weight pack was created for " + std::to_string(pack->channels()) + " memory channels!");
+                    }
+                }
+                bool split = false;
+                std::vector<OffloadAdapter::WeightBlock> &blocks = this->_weightBlocks;
+                try {
+                    for (auto const &layer : layers) {
+                        if (layer.layer & Layers::split) {
+                            multiple = layer.split;
+                            split = true;
+                        } else if(layer.layer & Layers::merge) {
+                            multiple = 1;
+                            split = false;
+                        } else if (layer.layer & Layers::conv) {
+                            if (split) {
+                                if (layer.iterations > 1) {
+                                    std::cerr << "Current implementation doesn't allow multi iteration layers in split mode!" << std::endl;
+                                    throw std::runtime_error("Multi iteration layer embedded in split mode!");
                                 }
-                                // this->_platform.flushCache(this->_platform.getPhys((void *)work), layer.convMem);
-                                this->_weightBuffers[memoryChannel].emplace_back(this, work, false);
-                            } // for each memory channel
-                            weightFileIndex++;
-                        } // for multiple weightFiles
+                            } else {
+                                multiple = layer.iterations;
+                            }
+                            for (unsigned int i = 0; i < multiple; i++) { //for splits or multi iteration layers
+                                unsigned int const weightIndex = this->_weights.add();
+                                for (unsigned int memoryChannel = 0; memoryChannel < memoryChannels; memoryChannel++) { //for every memory channel
+                                    this->_weights.at(weightIndex, memoryChannel).size = layer.convMem;
+                                    blocks.push_back({&layer, weightFileIndex, layers.getBinparamSkip() + weightIndex, memoryChannel, NULL});
+                                } // for each memory channel
+                                this->_weightState.push_back(WEIGHTS_UNLOADED);
+                                this->_weightPins.push_back(0);
+                                this->_weightErrors.emplace_back();
+                                // grouped layers combine the files of all groups in one row
+                                weightFileIndex += layer.groups;
+                            } // for multiple weightFiles
+                        }
+                    }
+
+                    if (this->_weightLoading != WEIGHTS_LOADING_EAGER) {
+                        return;
                     }
+
+                    // contiguous memory is reserved up front, the allocator is not thread safe
+                    for (auto &block : blocks) {
+                        this->_allocWeightBlock(block);
+                    }
+                    std::mutex errorLock;
+                    std::exception_ptr error;
+                    for (auto const &block : blocks) {
+                        jobber.add([this, &block, &errorLock, &error](){
+                            try {
+                                this->_loadWeightBlock(block);
+                            } catch(...) {
+                                std::lock_guard<std::mutex> lock(errorLock);
+                                error = std::current_exception();
+                            }
+                        });
+                    }
+                    while (jobber.work()) {}
+                    jobber.wait();
+                    if (error) {
+                        std::rethrow_exception(error);
+                    }
+                    std::fill(this->_weightState.begin(), this->_weightState.end(), WEIGHTS_LOADED);
+                } catch(...) {
+                    this->_freeWeights();
+                    throw;
                 }
+                // everything is resident, the plan is not needed anymore
+                pack.reset();
+                if (cachePath.size() > 0 && !cached) {
+                    // a failing cache must not fail the initialization
+                    std::string const tempPath = cachePath + "." + std::to_string(getpid());
+                    try {
+                        WeightPack::write(tempPath, this->_weights, layers.getBinparamSkip(), cacheKey);
+                        if (std::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+                            throw std::runtime_error("Could not rename " + tempPath);
+                        }
+                    } catch(std::exception const &e) {
+                        std::remove(tempPath.c_str());
+                        std::cerr << "Could not write weight cache " << cachePath << ": " << e.what() << std::endl;
+                    }
+                }
+                // for (auto const &block : blocks) this->_platform.flushCache(this->_platform.getPhys((void *)block.buffer), block.layer->convMem);
             }
         };
 
@@ -308,28 +551,563 @@ class OffloadAdapter {
         }
 
     private:
+        /**
+         * one block of the weight loading plan, the weights and treshholds of
+         * a single binparam file index and memory channel. Grouped layers
+         * read the file indices of all groups, starting at fileIndex. Packs
+         * and readers hold the prepared rows, they are addressed by the row
+         * index behind the binparam skip
+         */
+        struct WeightBlock {
+            Layers::Layer const *layer;
+            unsigned int fileIndex;
+            unsigned int rowIndex;
+            unsigned int channel;
+            ExtMemWord *buffer;
+        };
+
+        /**
+         * holds the buffers of the running offload, they stay locked and
+         * referenced until the offload is synced. A batched offload adds
+         * the buffers of every image
+         */
         struct SyncData {
-            SyncData() : synced(true), input(NULL), output(NULL) {};
+            SyncData() : synced(true) {};
             std::atomic<bool> synced;
-            OffloadAdapter::ExtMemBuffer *input;
-            OffloadAdapter::ExtMemBuffer *output;
+            std::vector<OffloadAdapter::BufferView> buffers;
+            std::vector<std::unique_lock<std::mutex>> locks;
+
+            void acquire(OffloadAdapter::BufferView const &in, OffloadAdapter::BufferView const &out) {
+                this->_lock(in);
+                this->_lock(out);
+                this->synced = false;
+            }
+
+            void release() {
+                for (auto &lock : this->locks) {
+                    lock.unlock();
+                }
+                for (auto &buffer : this->buffers) {
+                    buffer->cond.notify_all();
+                }
+                this->locks.clear();
+                this->buffers.clear();
+                this->synced = true;
+            }
+
+            private:
+                void _lock(OffloadAdapter::BufferView const &buffer) {
+                    // a buffer can be used by several images of a batch
+                    for (auto const &held : this->buffers) {
+                        if (held.get() == buffer.get()) {
+                            return;
+                        }
+                    }
+                    this->buffers.push_back(buffer);
+                    this->locks.emplace_back(buffer->lock);
+                }
+        };
+
+        /**
+         * weights of the shadow bank, requested by prefetchWeights, streamed
+         * along the next offload and committed by offloadWeights
+         */
+        struct WeightPrefetch {
+            WeightPrefetch() : layer(NULL), entries(NULL), index(-1), streaming(-1), shadow(-1) {};
+            //requested weights, streamed with the next offload
+            Layers::Layer const *layer;
+            WeightTable::Entry const *entries;
+            unsigned int index;
+            //weights streaming with the running offload
+            unsigned int streaming;
+            //weights in the shadow bank
+            unsigned int shadow;
+
+            bool requested() const {
+                return this->layer != NULL;
+            }
+
+            bool holds(unsigned int weightIndex) const {
+                return (this->shadow == weightIndex) || (this->streaming == weightIndex) ||
+                    (this->requested() && this->index == weightIndex);
+            }
+
+            // without exact weights the whole memory is streamed
+            unsigned int IFMCh() const {
+                return this->layer->network.getDescriptor().exactWeights ? this->layer->IFMCh : 0;
+            }
+
+            unsigned int OFMCh() const {
+                return this->layer->network.getDescriptor().exactWeights ? this->layer->OFMCh : 0;
+            }
+
+            unsigned int groups() const {
+                return this->layer->network.getDescriptor().exactWeights ? this->layer->groups : 1;
+            }
+
+            void start() {
+                this->streaming = this->index;
+                this->shadow = -1;
+                this->layer = NULL;
+                this->entries = NULL;
+                this->index = -1;
+            }
+
+            void synced() {
+                if (this->streaming != (unsigned int) -1) {
+                    this->shadow = this->streaming;
+                    this->streaming = -1;
+                }
+            }
+
+            bool commit(unsigned int weightIndex) {
+                if (this->shadow != weightIndex) {
+                    return false;
+                }
+                this->shadow = -1;
+                return true;
+            }
         };
 
+        /**
+         * writes the batch table of a batched offload, the word offsets of
+         * the input and output buffer of every image to the first image
+         * @param inputBuffers  input buffer per image
+         * @param outputBuffers output buffer per image
+         */
+        void _fillBatchTable(std::vector<OffloadAdapter::BufferView> const &inputBuffers, std::vector<OffloadAdapter::BufferView> const &outputBuffers) {
+            if (inputBuffers.empty() || (inputBuffers.size() != outputBuffers.size())) {
+                throw std::runtime_error("Batched offload needs one input and one output buffer per image");
+            }
+            if (inputBuffers.size() > OFFLOAD_MAX_IMAGES) {
+                throw std::runtime_error("Batched offload supports at most " + std::to_string(OFFLOAD_MAX_IMAGES) + " images");
+            }
+            if (this->_batchTable == NULL) {
+                this->_batchTable = this->malloc(OFFLOAD_MAX_IMAGES * 2 * sizeof(ExtMemWord));
+            }
+            unsigned long long const input = this->phys(inputBuffers[0]->buffer);
+            unsigned long long const output = this->phys(outputBuffers[0]->buffer);
+            for (unsigned int i = 0; i < inputBuffers.size(); i++) {
+                // the offsets wrap around for buffers below the first one
+                this->_batchTable[2 * i] = (ExtMemWord) ((long long) (this->phys(inputBuffers[i]->buffer) - input) / (long long) sizeof(ExtMemWord));
+                this->_batchTable[(2 * i) + 1] = (ExtMemWord) ((long long) (this->phys(outputBuffers[i]->buffer) - output) / (long long) sizeof(ExtMemWord));
+            }
+        }
+
         std::atomic<bool> _running;
         OffloadAdapter::SyncData _syncData;
+        ExtMemWord *_batchTable;
+        OffloadAdapter::WeightPrefetch _weightPrefetch;
 
         static std::list<OffloadAdapter *> _instances;
         bool _isHardware;
+        unsigned int _weightBanks;
         size_t _bufferSize;
+        unsigned int _localPages;
+        std::string _weightCache;
+        OffloadAdapter::WeightReader _weightReader;
+        unsigned int _weightLoading;
+        size_t _weightBudget;
+        size_t _weightResident;
+        unsigned int _weightActive;
+        std::string _weightRoot;
+        std::unique_ptr<WeightPack> _weightPack;
+        Jobber *_weightJobber;
+        std::vector<OffloadAdapter::WeightBlock> _weightBlocks;
+        std::vector<unsigned char> _weightState;
+        std::vector<unsigned int> _weightPins;
+        std::vector<std::exception_ptr> _weightErrors;
+        std::list<unsigned int> _weightLru;
+        std::mutex _weightLock;
+        std::condition_variable _weightCondition;
         std::list<OffloadAdapter::ExtMemBuffer> _buffers;
         std::list<OffloadAdapter::ExtMemBuffer> _localBuffers;
-        std::vector<std::list<OffloadAdapter::ExtMemBuffer>> _weightBuffers;
+        WeightTable _weights;
         std::vector<OffloadAdapter::ExtMemBuffer *> _unusedBuffers;
         std::vector<OffloadAdapter::ExtMemBuffer *> _localUnusedBuffers;
         std::mutex _bufferLock;
         std::condition_variable _bufferCondition;
         void *_platform;
 
+        /**
+         * allocates a local buffer, backed by huge pages if requested.
+         * Explicit huge pages fall back to transparent huge pages and those
+         * to the normal heap. All pages are touched once, so the first
+         * inference does not pay for page faults
+         * @param mapped set to the mapping size or 0 for heap buffers
+         * @return the local buffer
+         */
+        ExtMemWord *_localMalloc(size_t &mapped) {
+            size_t const hugePageSize = GeneralUtils::getHugePageSize();
+            size_t const size = GeneralUtils::padTo(this->_bufferSize, hugePageSize);
+            void *buffer = MAP_FAILED;
+            mapped = 0;
+#ifdef MAP_HUGETLB
+            if (this->_localPages == LOCALBUFFER_PAGES_EXPLICIT) {
+                buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+            }
+#endif
+            if (buffer == MAP_FAILED && this->_localPages != LOCALBUFFER_PAGES_DEFAULT) {
+                // map one huge page more, so the buffer can start on a huge page boundary
+                char *area = (char *) mmap(NULL, size + hugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (area != MAP_FAILED) {
+                    size_t const head = (hugePageSize - ((uintptr_t) area % hugePageSize)) % hugePageSize;
+                    char *aligned = area + head;
+                    if (head > 0) {
+                        munmap(area, head);
+                    }
+                    munmap(aligned + size, hugePageSize - head);
+#ifdef MADV_HUGEPAGE
+                    madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+                    buffer = aligned;
+                }
+            }
+            if (buffer != MAP_FAILED) {
+                mapped = size;
+                // pin the staging buffer, failing is not critical
+                mlock(buffer, mapped);
+            } else {
+                buffer = new ExtMemWord[this->_bufferSize / sizeof(ExtMemWord)];
+            }
+            size_t const pageSize = (mapped) ? hugePageSize : GeneralUtils::getPageSize();
+            for (size_t offset = 0; offset < this->_bufferSize; offset += pageSize) {
+                ((volatile char *) buffer)[offset] = 0;
+            }
+            return (ExtMemWord *) buffer;
+        }
+
+        void _localFree(ExtMemWord *buffer, size_t const mapped) {
+            if (mapped) {
+                munmap((void *) buffer, mapped);
+            } else {
+                delete [] buffer;
+            }
+        }
+
+        /**
+         * reserves the contiguous buffer of a planned block and enters it
+         * into the weight table
+         * @param block planned block
+         */
+        void _allocWeightBlock(OffloadAdapter::WeightBlock &block) {
+            // lazy loading allocates next to the buffer pool
+            std::lock_guard<std::mutex> locker(this->_bufferLock);
+            ExtMemWord *work = this->malloc(block.layer->convMem);
+            if(!work) {
+                throw std::runtime_error("Could not allocate contiguous memory!");
+            }
+            unsigned int const index = &block - this->_weightBlocks.data();
+            WeightTable::Entry &entry = this->_weights.at(index / this->_weights.channels(), block.channel);
+            entry.buffer = work;
+            entry.phys = this->phys(work);
+            block.buffer = work;
+        }
+
+        /**
+         * frees the buffer of a block and removes it from the weight table
+         * @param block planned block
+         */
+        void _freeWeightBlock(OffloadAdapter::WeightBlock &block) {
+            unsigned int const index = &block - this->_weightBlocks.data();
+            WeightTable::Entry &entry = this->_weights.at(index / this->_weights.channels(), block.channel);
+            if (block.buffer) {
+                std::lock_guard<std::mutex> locker(this->_bufferLock);
+                this->free(block.buffer);
+            }
+            entry.buffer = NULL;
+            entry.phys = 0;
+            block.buffer = NULL;
+        }
+
+        /**
+         * helper function for OffloadAdapter::loadWeights
+         * fills one planned block, either through the weight reader, from the
+         * weight pack or from the weight and treshhold files of every PE of
+         * the memory channel. Grouped layers combine the files of every group
+         * @param block    planned block with a reserved buffer
+         */
+        void _loadWeightBlock(OffloadAdapter::WeightBlock const &block) {
+            Layers::Layer const &layer = *block.layer;
+            WeightPack const *pack = this->_weightPack.get();
+            ExtMemWord *work = block.buffer;
+            if (this->_weightReader) {
+                this->_weightReader(block.rowIndex, block.channel, work, layer.convMem);
+                return;
+            }
+            if (pack) {
+                if (pack->size(block.rowIndex, block.channel) != layer.convMem) {
+                    throw std::runtime_error("Weight pack block " + std::to_string(block.rowIndex) + "-" + std::to_string(block.channel) + " does not match the layer memory size!");
+                }
+                std::memcpy((void *) work, pack->data(block.rowIndex, block.channel), layer.convMem);
+                return;
+            }
+            if (layer.groups <= 1) {
+                this->_loadWeightFile(work, block.fileIndex, block.channel, layer);
+                return;
+            }
+            std::memset((void *) work, 0, layer.convMem);
+            std::vector<ExtMemWord> group(layer.convMem / sizeof(ExtMemWord));
+            for (unsigned int g = 0; g < layer.groups; g++) {
+                this->_loadWeightFile(group.data(), block.fileIndex + g, block.channel, layer);
+                this->_placeWeightGroup(work, group.data(), g, layer);
+            }
+        }
+
+        /**
+         * helper function for OffloadAdapter::_loadWeightBlock
+         * copies the weights and treshholds of one group into the block of
+         * a grouped layer. The neuron folds of group g follow the ones of
+         * the groups before, so its weights start at g times the weight
+         * entries and its treshholds at g times the treshhold entries of
+         * one group
+         * @param work      block of the grouped layer
+         * @param group     block of the group, prepared like a single layer
+         * @param g         group index
+         * @param layer     grouped layer parameters
+         */
+        void _placeWeightGroup(ExtMemWord *work, ExtMemWord const *group, unsigned int const g, Layers::Layer const &layer) {
+            unsigned int const maxPE = layer.network.getMaxPEConv();
+            unsigned int const maxSIMD = layer.network.getMaxSIMD();
+            unsigned int const maxPeIndex = (unsigned int) std::floor(maxPE / this->_weights.channels());
+            unsigned int const shift = std::ceil((float) layer.network.getTreshholdsBits() / (float) layer.network.getDatawidth());
+            unsigned int const groupIFMCh = layer.IFMCh / layer.groups;
+            unsigned int const groupOFMCh = layer.OFMCh / layer.groups;
+            unsigned long const neuronFold = groupOFMCh / maxPE;
+            unsigned long const weightEntries = neuronFold * ((layer.kernelDim * layer.kernelDim * groupIFMCh) / maxSIMD);
+            unsigned long const treshholdOffset = maxPeIndex * layer.convWMem;
+            for (unsigned int peIndex = 0; peIndex < maxPeIndex; peIndex++) {
+                unsigned long const weights = peIndex * layer.convWMem;
+                unsigned long const treshholds = treshholdOffset + (peIndex * layer.convTMem * shift);
+                std::memcpy((void *) &work[weights + (g * weightEntries)], (void const *) &group[weights], weightEntries * sizeof(ExtMemWord));
+                std::memcpy((void *) &work[treshholds + (g * neuronFold * shift)], (void const *) &group[treshholds], neuronFold * shift * sizeof(ExtMemWord));
+            }
+        }
+
+        /**
+         * helper function for OffloadAdapter::_loadWeightBlock
+         * reads the weight and treshhold files of one binparam file index
+         * for every PE of the memory channel
+         * @param work      target buffer of layer.convMem bytes
+         * @param fileIndex binparam file index
+         * @param channel   memory channel
+         * @param layer     layer parameters
+         */
+        void _loadWeightFile(ExtMemWord *work, unsigned int const fileIndex, unsigned int const channel, Layers::Layer const &layer) {
+            std::string const &dataRoot = this->_weightRoot;
+            unsigned int const maxSIMD = layer.network.getMaxSIMD();
+            unsigned int const maxPeIndex = (unsigned int) std::floor(layer.network.getMaxPEConv() / this->_weights.channels());
+            unsigned long const treshholdOffset = maxPeIndex * layer.convWMem;
+            for (unsigned int peIndex = 0; peIndex < maxPeIndex; peIndex++) { // for every weight file
+                std::string const filePrefix(dataRoot + "/" + std::to_string(fileIndex) + "-" + std::to_string(peIndex + (channel * maxPeIndex)));
+                // debug_info("Load file %s\n", std::string(filePrefix + "-weights.bin").c_str());
+                std::string weightFilename(filePrefix + "-weights.bin");
+                // debug_info("Load file %s\n", std::string(filePrefix + "-thres.bin").c_str());
+                std::string treshholdFilename(filePrefix + "-thres.bin");
+                std::ifstream weightFile(weightFilename, std::ios::binary | std::ios::in);
+                if (!weightFile.is_open()) {
+                    throw std::runtime_error("Could not open " + weightFilename);
+                }
+                std::ifstream treshholdFile(treshholdFilename, std::ios::binary | std::ios::in);
+                if (!treshholdFile.is_open()) {
+                    throw std::runtime_error("Could not open " + treshholdFilename);
+                }
+                if (fileIndex == 0 && (layer.IFMCh * layer.stride) < maxSIMD) {
+                    this->_loadFirstLayerWeights(work, 0, peIndex, weightFile, layer);
+                } else {
+                    this->_loadLayerWeights(work, 0, peIndex, weightFile, layer);
+                }
+                this->_loadLayerTreshholds(work, treshholdOffset, peIndex, treshholdFile, layer);
+                weightFile.close();
+                treshholdFile.close();
+            } //for each PEIndex
+        }
+
+        /**
+         * returns the row of a weight index for offloadWeights, lazy and
+         * prefetch loading make sure the row is resident first. The row
+         * stays pinned until offloadWeights uses the next row
+         * @param index weight index
+         * @return      resident row
+         */
+        WeightTable::Entry const *_useWeights(unsigned int index) {
+            WeightTable::Entry const *row = this->_pinWeights(index);
+            if (this->_weightLoading != WEIGHTS_LOADING_EAGER) {
+                if (this->_weightActive != (unsigned int) -1) {
+                    this->_unpinWeights(this->_weightActive);
+                }
+                this->_weightActive = index;
+            }
+            return row;
+        }
+
+        /**
+         * makes the row of a weight index resident and pins it, pinned rows
+         * are never evicted. A failed background load of the row is thrown
+         * here. Prefetch loading queues the next row on the jobber
+         * @param index weight index
+         * @return      resident row
+         */
+        WeightTable::Entry const *_pinWeights(unsigned int index) {
+            if (this->_weightLoading == WEIGHTS_LOADING_EAGER) {
+                return this->_weights.row(index);
+            }
+            if (index >= this->_weightState.size()) {
+                throw std::out_of_range("Weight index " + std::to_string(index) + " is not planned!");
+            }
+            std::unique_lock<std::mutex> lk(this->_weightLock);
+            if (this->_weightErrors[index]) {
+                std::exception_ptr error = this->_weightErrors[index];
+                this->_weightErrors[index] = nullptr;
+                std::rethrow_exception(error);
+            }
+            this->_weightPins[index]++;
+            lk.unlock();
+            try {
+                this->_loadWeightRow(index);
+            } catch(...) {
+                this->_unpinWeights(index);
+                throw;
+            }
+            if (this->_weightLoading == WEIGHTS_LOADING_PREFETCH && index + 1 < this->_weightState.size()) {
+                unsigned int const next = index + 1;
+                this->_weightJobber->add([this, next](){
+                    try {
+                        this->_loadWeightRow(next);
+                    } catch(...) {
+                        // kept for the next use of the row, unless another
+                        // thread loaded it meanwhile
+                        std::lock_guard<std::mutex> lock(this->_weightLock);
+                        if (this->_weightState[next] == WEIGHTS_UNLOADED) {
+                            this->_weightErrors[next] = std::current_exception();
+                        }
+                    }
+                });
+            }
+            return this->_weights.row(index);
+        }
+
+        /**
+         * drops one pin of a weight index, the row can be evicted again once
+         * no pin is left
+         * @param index weight index
+         */
+        void _unpinWeights(unsigned int index) {
+            if (this->_weightLoading == WEIGHTS_LOADING_EAGER) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(this->_weightLock);
+            if (this->_weightPins[index] > 0) {
+                this->_weightPins[index]--;
+            }
+        }
+
+        /**
+         * the shadow bank only exists in accelerators built with two weight
+         * banks, single bank builds ignore WEIGHT_PREFETCH
+         * @param network descriptor of the offloaded network
+         * @return true if weights are prefetched and committed
+         */
+        bool _prefetching(Network::Descriptor const &network) const {
+            return network.weightPrefetch && (this->_weightBanks > 1);
+        }
+
+        /**
+         * called by sync, the shadow bank holds the streamed row now and its
+         * pin can be dropped
+         */
+        void _syncWeightPrefetch() {
+            if (this->_weightPrefetch.streaming != (unsigned int) -1) {
+                this->_unpinWeights(this->_weightPrefetch.streaming);
+            }
+            this->_weightPrefetch.synced();
+        }
+
+        /**
+         * loads all blocks of a weight index if they are not resident, other
+         * threads loading the same row are waited for. Exceeding the budget
+         * evicts least recently used rows first
+         * @param index weight index
+         */
+        void _loadWeightRow(unsigned int index) {
+            unsigned int const channels = this->_weights.channels();
+            std::unique_lock<std::mutex> lk(this->_weightLock);
+            this->_weightCondition.wait(lk, [this, index](){ return this->_weightState[index] != WEIGHTS_LOADING; });
+            if (this->_weightState[index] == WEIGHTS_LOADED) {
+                this->_weightLru.remove(index);
+                this->_weightLru.push_back(index);
+                return;
+            }
+            this->_weightState[index] = WEIGHTS_LOADING;
+            size_t rowSize = 0;
+            for (unsigned int c = 0; c < channels; c++) {
+                rowSize += this->_weights.at(index, c).size;
+            }
+            if (this->_weightBudget > 0) {
+                auto victim = this->_weightLru.begin();
+                while (this->_weightResident + rowSize > this->_weightBudget && victim != this->_weightLru.end()) {
+                    if (this->_weightPins[*victim] > 0) {
+                        victim++;
+                        continue;
+                    }
+                    for (unsigned int c = 0; c < channels; c++) {
+                        this->_freeWeightBlock(this->_weightBlocks[(*victim * channels) + c]);
+                        this->_weightResident -= this->_weights.at(*victim, c).size;
+                    }
+                    this->_weightState[*victim] = WEIGHTS_UNLOADED;
+                    victim = this->_weightLru.erase(victim);
+                }
+            }
+            try {
+                for (unsigned int c = 0; c < channels; c++) {
+                    this->_allocWeightBlock(this->_weightBlocks[(index * channels) + c]);
+                }
+                lk.unlock();
+                for (unsigned int c = 0; c < channels; c++) {
+                    this->_loadWeightBlock(this->_weightBlocks[(index * channels) + c]);
+                }
+                lk.lock();
+            } catch(...) {
+                if (!lk.owns_lock()) {
+                    lk.lock();
+                }
+                for (unsigned int c = 0; c < channels; c++) {
+                    this->_freeWeightBlock(this->_weightBlocks[(index * channels) + c]);
+                }
+                this->_weightState[index] = WEIGHTS_UNLOADED;
+                lk.unlock();
+                this->_weightCondition.notify_all();
+                throw;
+            }
+            this->_weightState[index] = WEIGHTS_LOADED;
+            this->_weightErrors[index] = nullptr;
+            this->_weightResident += rowSize;
+            this->_weightLru.push_back(index);
+            lk.unlock();
+            this->_weightCondition.notify_all();
+        }
+
+        /**
+         * frees all weight buffers of the weight table
+         */
+        void _freeWeights() {
+            for (auto &entry : this->_weights) {
+                if (entry.buffer) {
+                    this->free(entry.buffer);
+                }
+            }
+            this->_weights.clear();
+            this->_weightBlocks.clear();
+            this->_weightState.clear();
+            this->_weightPins.clear();
+            this->_weightErrors.clear();
+            this->_weightActive = -1;
+            this->_weightPrefetch = OffloadAdapter::WeightPrefetch();
+            this->_weightLru.clear();
+            this->_weightResident = 0;
+            this->_weightPack.reset();
+        }
+
         /**
          * helper function for OffloadAdapter::loadWeights
          * implements the first layer weights with the packing of IFMCh * KerStride
@@ -401,5 +1179,8 @@ class OffloadAdapter {
 
 };
 
+inline void OffloadAdapter::BufferReleaser::operator()(OffloadAdapter::ExtMemBuffer *buf) const {
+    buf->_release();
+}
 
 #endif
@@ -31,18 +31,346 @@
 
 #include "offload-utils.h"
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 unsigned long long OffloadUtils::_wrongPixels = 0;
+size_t OffloadUtils::_copyChunk = PARALLEL_COPY_CHUNK;
 
 void OffloadUtils::padTo(char * bufferPadded, size_t const outputSize, char * bufferUnpadded, size_t const inputSize, unsigned int const elements) {
-    unsigned int const inputElementBits = (inputSize * 8) / (elements);
-    unsigned int const outputElementBits = (outputSize * 8) / (elements);
-    unsigned int const copyBits = (inputElementBits < outputElementBits) ? inputElementBits : outputElementBits;
-    OffloadUtils::memset(bufferPadded, 0, outputSize);
-    for (unsigned int i = 0; i < elements; i++) {
-        OffloadUtils::bitcpy(bufferPadded, i * outputElementBits, bufferUnpadded, i * inputElementBits, copyBits);
+    OffloadUtils::PadPlan const plan = OffloadUtils::padPlan(outputSize, inputSize, elements);
+    OffloadUtils::padTo(plan, bufferPadded, bufferUnpadded, 0, elements);
+}
+
+/**
+ * computes the layout conversion between an unpadded and a padded buffer
+ * holding the same number of elements, e.g. the pixels of an image
+ * @param outputSize bytes of the buffer to write
+ * @param inputSize  bytes of the buffer to read
+ * @param elements   number of elements in both buffers
+ * @return plan for OffloadUtils::padTo
+ */
+OffloadUtils::PadPlan OffloadUtils::padPlan(size_t const outputSize, size_t const inputSize, unsigned int const elements) {
+    OffloadUtils::PadPlan plan;
+    plan.outputSize = outputSize;
+    plan.inputSize = inputSize;
+    plan.elements = elements;
+    if (elements == 0) {
+        return plan;
+    }
+    plan.inputBits = (inputSize * 8) / elements;
+    plan.outputBits = (outputSize * 8) / elements;
+    plan.copyBits = (plan.inputBits < plan.outputBits) ? plan.inputBits : plan.outputBits;
+    plan.bytes = (plan.inputBits % 8 == 0) && (plan.outputBits % 8 == 0);
+    // rows of about 32 KiB output, starting on a 64 bit boundary
+    // the lowest set bit of the element size decides how many elements fill whole words
+    unsigned int const lowBit = plan.outputBits & (~plan.outputBits + 1);
+    unsigned int const align = (plan.outputBits > 0) ? 64 / std::min(lowBit, 64u) : 1;
+    unsigned int const rowBits = 32 * 1024 * 8;
+    unsigned int const rowElements = (plan.outputBits > 0) ? std::max(1u, rowBits / plan.outputBits) : elements;
+    plan.rowElements = GeneralUtils::padTo(rowElements, align);
+    return plan;
+}
+
+/**
+ * converts the elements first to last of a planned layout, the padding bits
+ * are set to 0. Whole byte layouts are copied row wise, the others go
+ * through the vectorized bitcpy. The last row also clears the bytes behind
+ * the last element
+ * @param plan           plan of OffloadUtils::padPlan
+ * @param bufferPadded   buffer to write
+ * @param bufferUnpadded buffer to read
+ * @param first          first element, start of a row
+ * @param last           element behind the last one, end of a row or elements
+ */
+void OffloadUtils::padTo(OffloadUtils::PadPlan const &plan, char *bufferPadded, char *bufferUnpadded, unsigned int const first, unsigned int const last) {
+    size_t const begin = ((size_t) first * plan.outputBits) / 8;
+    size_t const end = (last == plan.elements) ? plan.outputSize : ((size_t) last * plan.outputBits) / 8;
+    if (!plan.bytes) {
+        OffloadUtils::deviceMemset(bufferPadded + begin, 0, end - begin);
+        for (unsigned int i = first; i < last; i++) {
+            OffloadUtils::bitcpy(bufferPadded, (size_t) i * plan.outputBits, bufferUnpadded, (size_t) i * plan.inputBits, plan.copyBits);
+        }
+        return;
+    }
+    size_t const outputBytes = plan.outputBits / 8;
+    size_t const inputBytes = plan.inputBits / 8;
+    size_t const copyBytes = plan.copyBits / 8;
+    if (inputBytes == outputBytes) {
+        OffloadUtils::deviceMemcpy(bufferPadded + begin, bufferUnpadded + (first * inputBytes), (last - first) * outputBytes);
+    } else {
+        for (size_t i = first; i < last; i++) {
+            OffloadUtils::deviceMemcpy(bufferPadded + (i * outputBytes), bufferUnpadded + (i * inputBytes), copyBytes);
+            OffloadUtils::deviceMemset(bufferPadded + (i * outputBytes) + copyBytes, 0, outputBytes - copyBytes);
+        }
+    }
+    size_t const converted = (size_t) last * outputBytes;
+    if (end > converted) {
+        OffloadUtils::deviceMemset(bufferPadded + converted, 0, end - converted);
+    }
+}
+
+/**
+ * converts all rows of a planned layout, the rows are spread over the
+ * jobber and the calling thread helps working them off
+ * @param plan           plan of OffloadUtils::padPlan
+ * @param bufferPadded   buffer to write
+ * @param bufferUnpadded buffer to read
+ * @param jobber         pool the rows are converted on
+ * @param threading      false converts all rows on the calling thread
+ */
+void OffloadUtils::padTo(OffloadUtils::PadPlan const &plan, char *bufferPadded, char *bufferUnpadded, Jobber &jobber, bool const threading) {
+    if (!threading || plan.elements <= plan.rowElements) {
+        OffloadUtils::padTo(plan, bufferPadded, bufferUnpadded, 0, plan.elements);
+        return;
+    }
+    for (unsigned int first = 0; first < plan.elements; first += plan.rowElements) {
+        unsigned int const last = std::min(first + plan.rowElements, plan.elements);
+        jobber.add([&plan, bufferPadded, bufferUnpadded, first, last](){
+            OffloadUtils::padTo(plan, bufferPadded, bufferUnpadded, first, last);
+        });
+    }
+    while (jobber.work()) {}
+    jobber.wait();
+}
+
+/**
+ * packs planar 8 bit activations into the accelerator layout in one pass.
+ * The activationBits low bits of every channel follow each other starting
+ * at bit 0 of the pixel, the rest of the pixel is set to 0. Bits are
+ * collected in a 64 bit word and stored word wise, so hardware buffers are
+ * written without read backs
+ * @param target         first pixel to write, 8 byte aligned
+ * @param targetStride   bytes per pixel, multiple of 8
+ * @param source         first value of channel 0
+ * @param channelStride  values between two channels of a pixel
+ * @param channels       channels per pixel
+ * @param pixels         number of pixels
+ * @param activationBits bits per activation, up to 8
+ */
+void OffloadUtils::packActivations(char *target, size_t const targetStride, unsigned char const *source, size_t const channelStride, unsigned int const channels, unsigned int const pixels, unsigned int const activationBits) {
+    if (activationBits > 8 || (size_t) channels * activationBits > targetStride * 8) {
+        throw std::runtime_error("Activations do not fit into " + std::to_string(targetStride) + " bytes per pixel!");
+    }
+    unsigned char const mask = (unsigned char) ((1u << activationBits) - 1);
+    size_t const words = targetStride / sizeof(uint64_t);
+    for (unsigned int p = 0; p < pixels; p++) {
+        uint64_t *pixel = (uint64_t *) (target + (p * targetStride));
+        unsigned char const *value = source + p;
+        uint64_t word = 0;
+        unsigned int fill = 0;
+        size_t w = 0;
+        for (unsigned int c = 0; c < channels; c++, value += channelStride) {
+            uint64_t const bits = *value & mask;
+            word |= bits << fill;
+            fill += activationBits;
+            if (fill >= 64) {
+                pixel[w++] = word;
+                fill -= 64;
+                // the part of the activation that did not fit
+                word = (fill > 0) ? bits >> (activationBits - fill) : 0;
+            }
+        }
+        if (fill > 0) {
+            pixel[w++] = word;
+        }
+        for (; w < words; w++) {
+            pixel[w] = 0;
+        }
+    }
+}
+
+/**
+ * decodes the activations of the accelerator layout into interleaved
+ * values, the inverse of OffloadUtils::packActivations
+ * @param target         first value of the first pixel, channels per pixel
+ * @param source         first pixel to read, 8 byte aligned
+ * @param sourceStride   bytes per pixel, multiple of 8
+ * @param channels       channels per pixel
+ * @param pixels         number of pixels
+ * @param activationBits bits per activation, up to 8
+ */
+void OffloadUtils::unpackActivations(float *target, char const *source, size_t const sourceStride, unsigned int const channels, unsigned int const pixels, unsigned int const activationBits) {
+    if (activationBits > 8 || (size_t) channels * activationBits > sourceStride * 8) {
+        throw std::runtime_error("Activations do not fit into " + std::to_string(sourceStride) + " bytes per pixel!");
+    }
+    uint64_t const mask = (1u << activationBits) - 1;
+    for (unsigned int p = 0; p < pixels; p++) {
+        uint64_t const *pixel = (uint64_t const *) (source + (p * sourceStride));
+        float *value = target + ((size_t) p * channels);
+        uint64_t word = pixel[0];
+        unsigned int used = 0;
+        size_t w = 0;
+        for (unsigned int c = 0; c < channels; c++) {
+            uint64_t bits = word >> used;
+            used += activationBits;
+            if (used >= 64) {
+                used -= 64;
+                // the activation continues in the next word
+                word = (++w < sourceStride / sizeof(uint64_t)) ? pixel[w] : 0;
+                bits |= (used > 0) ? word << (activationBits - used) : 0;
+            }
+            value[c] = (float) (bits & mask);
+        }
+    }
+}
+
+/**
+ * reads bytes as a little endian value, only the aligned words holding
+ * them are loaded, so uncached memory sees word reads instead of byte reads
+ * @param from  first byte to read
+ * @param bytes bytes to read, up to 8
+ * @return the bytes, from[0] in the lowest byte
+ */
+uint64_t OffloadUtils::_loadBytes(char const *from, size_t const bytes) {
+    unsigned int const shift = (uintptr_t) from % sizeof(uint64_t);
+    uint64_t const *from64 = (uint64_t const *) (from - shift);
+    uint64_t value = from64[0] >> (shift * 8);
+    if (shift + bytes > sizeof(uint64_t)) {
+        value |= from64[1] << (64 - (shift * 8));
+    }
+    return value;
+}
+
+/**
+ * writes the lowest bytes of a value with naturally aligned 4, 2 and 1
+ * byte stores, so at most three stores reach a hardware buffer
+ * @param to    first byte to write
+ * @param value bytes to write, to[0] gets the lowest byte
+ * @param bytes bytes to write, up to 7
+ */
+void OffloadUtils::_storeBytes(char *to, uint64_t value, size_t bytes) {
+    while (bytes > 0) {
+        uintptr_t const address = (uintptr_t) to;
+        if (bytes >= 4 && address % 4 == 0) {
+            *((uint32_t *) to) = (uint32_t) value;
+            value >>= 32;
+            to += 4;
+            bytes -= 4;
+        } else if (bytes >= 2 && address % 2 == 0) {
+            *((uint16_t *) to) = (uint16_t) value;
+            value >>= 16;
+            to += 2;
+            bytes -= 2;
+        } else {
+            *to = (char) value;
+            value >>= 8;
+            to++;
+            bytes--;
+        }
     }
 }
 
+/**
+ * writes whole words in blocks of 64 bytes, with non temporal stores on
+ * x86 and NEON register quads on ARM, the target is never read
+ * @param to    aligned words to write
+ * @param from  words to read, 8 byte aligned
+ * @param words words to copy
+ */
+void OffloadUtils::_streamWords(uint64_t *to, uint64_t const *from, size_t const words) {
+    size_t w = 0;
+#if (defined(__AVX2__) || defined(__SSE2__)) && defined(__x86_64__)
+    for (; w < words; w++) {
+        _mm_stream_si64((long long *) &to[w], (long long) from[w]);
+    }
+    _mm_sfence();
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; w + 8 <= words; w += 8) {
+        uint64x2_t const a = vld1q_u64(&from[w]);
+        uint64x2_t const b = vld1q_u64(&from[w + 2]);
+        uint64x2_t const c = vld1q_u64(&from[w + 4]);
+        uint64x2_t const d = vld1q_u64(&from[w + 6]);
+        vst1q_u64(&to[w], a);
+        vst1q_u64(&to[w + 2], b);
+        vst1q_u64(&to[w + 4], c);
+        vst1q_u64(&to[w + 6], d);
+    }
+#endif
+    for (; w < words; w++) {
+        to[w] = from[w];
+    }
+}
+
+/**
+ * fills whole words in blocks of 64 bytes, see OffloadUtils::_streamWords
+ * @param to    aligned words to write
+ * @param value word to write
+ * @param words words to fill
+ */
+void OffloadUtils::_streamFill(uint64_t *to, uint64_t const value, size_t const words) {
+    size_t w = 0;
+#if (defined(__AVX2__) || defined(__SSE2__)) && defined(__x86_64__)
+    for (; w < words; w++) {
+        _mm_stream_si64((long long *) &to[w], (long long) value);
+    }
+    _mm_sfence();
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint64x2_t const fill = vdupq_n_u64(value);
+    for (; w + 8 <= words; w += 8) {
+        vst1q_u64(&to[w], fill);
+        vst1q_u64(&to[w + 2], fill);
+        vst1q_u64(&to[w + 4], fill);
+        vst1q_u64(&to[w + 6], fill);
+    }
+#endif
+    for (; w < words; w++) {
+        to[w] = value;
+    }
+}
+
+/**
+ * memcpy for uncached hardware buffers. The target is aligned with at most
+ * three stores, then all words are written aligned. A differently aligned
+ * source is read in aligned words and shifted into place instead of being
+ * copied byte by byte. Reads never leave the words holding source bytes
+ * @param to   buffer to write
+ * @param from buffer to read
+ * @param size bytes to copy
+ */
+void OffloadUtils::deviceMemcpy(char *to, char const *from, size_t size) {
+    size_t const head = std::min(size, (sizeof(uint64_t) - ((uintptr_t) to % sizeof(uint64_t))) % sizeof(uint64_t));
+    if (head > 0) {
+        OffloadUtils::_storeBytes(to, OffloadUtils::_loadBytes(from, head), head);
+        to += head;
+        from += head;
+        size -= head;
+    }
+    size_t const words = size / sizeof(uint64_t);
+    unsigned int const shift = (uintptr_t) from % sizeof(uint64_t);
+    if (shift == 0) {
+        OffloadUtils::_streamWords((uint64_t *) to, (uint64_t const *) from, words);
+    } else if (words > 0) {
+        OffloadUtils::_funnelShift((uint64_t *) to, (uint64_t const *) (from - shift), shift * 8, words);
+    }
+    size_t const tail = size % sizeof(uint64_t);
+    if (tail > 0) {
+        size_t const copied = words * sizeof(uint64_t);
+        OffloadUtils::_storeBytes(to + copied, OffloadUtils::_loadBytes(from + copied, tail), tail);
+    }
+}
+
+/**
+ * memset for uncached hardware buffers, like OffloadUtils::deviceMemcpy
+ * the target is aligned with at most three stores and filled word wise
+ * @param to   buffer to write
+ * @param val  byte to write
+ * @param size bytes to set
+ */
+void OffloadUtils::deviceMemset(char *to, char const val, size_t size) {
+    uint64_t const value = 0x0101010101010101ULL * (unsigned char) val;
+    size_t const head = std::min(size, (sizeof(uint64_t) - ((uintptr_t) to % sizeof(uint64_t))) % sizeof(uint64_t));
+    OffloadUtils::_storeBytes(to, value, head);
+    to += head;
+    size -= head;
+    size_t const words = size / sizeof(uint64_t);
+    OffloadUtils::_streamFill((uint64_t *) to, value, words);
+    OffloadUtils::_storeBytes(to + (words * sizeof(uint64_t)), value, size % sizeof(uint64_t));
+}
+
 /**
  * Custom memcpy function for hardware buffers. If the size is not a multiple
  * of 8 the normal memcpy function will fail. This memcpy copies as much as it
@@ -54,13 +382,14 @@ void OffloadUtils::padTo(char * bufferPadded, size_t const outputSize, char * bu
 void OffloadUtils::memcpy(char *to, char *from, size_t size) {
     size_t const unalignedTo = ((unsigned long long) to) % 0x8;
     size_t const unalignedFrom = ((unsigned long long) from) % 0x8;
-    size_t const alignedBytes = (unalignedTo != unalignedFrom) ? 0 : ((size - unalignedTo) / 8) * 8;
+    size_t const head = (8 - unalignedTo) % 8;
+    size_t const alignedBytes = (unalignedTo != unalignedFrom || size < head) ? 0 : ((size - head) / 8) * 8;
     if (alignedBytes) {
         // We can copy aligned bytes effectivly with std::memcpy
-        if (unalignedTo > 0) {
+        if (head > 0) {
             // But we have to fix unaligned addresses
-            // debug_info("Fix alignment, unaligned copy %lu bytes from %p to %p...\n", (8 - unalignedTo), from, to);
-            for (size_t s = 0; s < (8 - unalignedTo); s++, to++, from++, size--) {
+            // debug_info("Fix alignment, unaligned copy %lu bytes from %p to %p...\n", head, from, to);
+            for (size_t s = 0; s < head; s++, to++, from++, size--) {
                 *to = *from;
             }
         }
@@ -88,6 +417,92 @@ void OffloadUtils::memset(char *to, char val, size_t size) {
     }
 }
 
+/**
+ * sets the chunk size of the parallel buffer copies
+ * @param chunk bytes per chunk, rounded down to 64 bytes, 0 disables the splitting
+ */
+void OffloadUtils::setCopyChunk(size_t const chunk) {
+    OffloadUtils::_copyChunk = (chunk / 64) * 64;
+}
+
+/**
+ * splits a byte range into chunks that are claimed by the calling thread
+ * and by up to one helper job per worker. Helpers that start after the
+ * last chunk was claimed return at once, so busy workers never delay the
+ * caller and the caller never runs unrelated jobs while holding locks
+ * @param size      bytes of the range
+ * @param range     converts the bytes [first, last)
+ * @param jobber    pool of the helpers
+ * @param threading false keeps the whole range on the calling thread
+ */
+void OffloadUtils::_parallel(size_t const size, std::function<void(size_t, size_t)> const &range, Jobber &jobber, bool const threading) {
+    size_t const chunk = OffloadUtils::_copyChunk;
+    if (!threading || chunk == 0 || size < 2 * chunk || jobber.workers() == 0) {
+        range(0, size);
+        return;
+    }
+    struct Chunks {
+        std::function<void(size_t, size_t)> range;
+        size_t size;
+        size_t chunk;
+        std::atomic<size_t> next;
+        std::atomic<size_t> done;
+    };
+    // helpers may start after the caller returned, they share the state
+    std::shared_ptr<Chunks> chunks = std::make_shared<Chunks>();
+    chunks->range = range;
+    chunks->size = size;
+    chunks->chunk = chunk;
+    chunks->next = 0;
+    chunks->done = 0;
+    auto claim = [](Chunks &c) {
+        size_t first;
+        while ((first = c.next.fetch_add(c.chunk)) < c.size) {
+            size_t const last = std::min(first + c.chunk, c.size);
+            c.range(first, last);
+            c.done += last - first;
+        }
+    };
+    size_t const helpers = std::min<size_t>(jobber.workers(), ((size + chunk - 1) / chunk) - 1);
+    for (size_t h = 0; h < helpers; h++) {
+        jobber.add([chunks, claim](){
+            claim(*chunks);
+        });
+    }
+    claim(*chunks);
+    while (chunks->done < size) {
+        std::this_thread::yield();
+    }
+}
+
+/**
+ * OffloadUtils::deviceMemcpy split into chunks on idle workers
+ * @param to        buffer to write
+ * @param from      buffer to read
+ * @param size      bytes to copy
+ * @param jobber    pool of the helpers
+ * @param threading false copies on the calling thread
+ */
+void OffloadUtils::parallelMemcpy(char *to, char const *from, size_t const size, Jobber &jobber, bool const threading) {
+    OffloadUtils::_parallel(size, [to, from](size_t first, size_t last){
+        OffloadUtils::deviceMemcpy(to + first, from + first, last - first);
+    }, jobber, threading);
+}
+
+/**
+ * OffloadUtils::deviceMemset split into chunks on idle workers
+ * @param to        buffer to write
+ * @param val       byte to write
+ * @param size      bytes to set
+ * @param jobber    pool of the helpers
+ * @param threading false fills on the calling thread
+ */
+void OffloadUtils::parallelMemset(char *to, char const val, size_t const size, Jobber &jobber, bool const threading) {
+    OffloadUtils::_parallel(size, [to, val](size_t first, size_t last){
+        OffloadUtils::deviceMemset(to + first, val, last - first);
+    }, jobber, threading);
+}
+
 void OffloadUtils::naiveMemcpy(char *to, char *from, size_t size) {
     for (size_t s = 0; s < size; s++) {
         to[s] = from[s];
@@ -95,11 +510,140 @@ void OffloadUtils::naiveMemcpy(char *to, char *from, size_t size) {
 }
 
 void OffloadUtils::bitcpy(char *target, size_t dstOffset, char *source, size_t srcOffset, size_t bits) {
+    OffloadUtils::bitcpy(target, 0, dstOffset, source, 0, srcOffset, bits, 1);
+}
+
+/**
+ * Strided batch of bit copies, copies bits from every source element to
+ * the matching target element. The offsets are normalized once for the
+ * whole batch, so the buffer kernels hand over all pixels in one call.
+ * Narrow elements are copied several per vector register, see
+ * OffloadUtils::_bitcpyLanes, the rest element by element.
+ * @param target       first target element
+ * @param targetStride bytes between two target elements, multiple of 8
+ * @param dstOffset    bit offset inside each target element
+ * @param source       first source element
+ * @param sourceStride bytes between two source elements, multiple of 8
+ * @param srcOffset    bit offset inside each source element
+ * @param bits         bits to copy per element
+ * @param count        number of elements
+ */
+void OffloadUtils::bitcpy(char *target, size_t targetStride, size_t dstOffset, char *source, size_t sourceStride, size_t srcOffset, size_t bits, size_t count) {
     //Normalize
     source += (srcOffset / 64) * 8;
     target += (dstOffset / 64) * 8;
     srcOffset = srcOffset % 64;
     dstOffset = dstOffset % 64;
+    size_t i = 0;
+    if (bits > 0 && (targetStride % 8) == 0 && (sourceStride % 8) == 0) {
+        i = OffloadUtils::_bitcpyLanes((uint64_t *) target, targetStride / 8, dstOffset,
+            (uint64_t const *) source, sourceStride / 8, srcOffset, bits, count);
+    }
+    for (; i < count; i++) {
+        OffloadUtils::_bitcpy(target + (i * targetStride), dstOffset, source + (i * sourceStride), srcOffset, bits);
+    }
+}
+
+/**
+ * copies narrow strided elements with one element per vector lane, 4 with
+ * AVX2 and 2 with NEON. Target word w of every element is the funnel shift
+ * of source words w + base and w + base + 1, the same shift for all words
+ * and lanes. Source words outside of an element are clamped to its first
+ * or last word, their bits only reach target bits outside of the copied
+ * range which are masked. Only partially written target words are read.
+ * @param target      first target element
+ * @param targetWords words between two target elements
+ * @param dstOffset   bit offset inside each target element, 0..63
+ * @param source      first source element
+ * @param sourceWords words between two source elements
+ * @param srcOffset   bit offset inside each source element, 0..63
+ * @param bits        bits to copy per element
+ * @param count       number of elements
+ * @return            number of leading elements copied, the rest is left
+ *                    for OffloadUtils::_bitcpy
+ */
+size_t OffloadUtils::_bitcpyLanes(uint64_t *target, size_t targetWords, unsigned int dstOffset, uint64_t const *source, size_t sourceWords, unsigned int srcOffset, size_t bits, size_t count) {
+#if !defined(__AVX2__) && !defined(__ARM_NEON) && !defined(__ARM_NEON__)
+    return 0;
+#endif
+    size_t const words = (dstOffset + bits + 63) / 64;
+    // lanes must not share target words
+    if (words > BITCPY_LANE_WORDS || targetWords < words) {
+        return 0;
+    }
+    size_t const lastSource = (srcOffset + bits - 1) / 64;
+    long const delta = (long) srcOffset - (long) dstOffset;
+    long const base = (delta < 0) ? -1 : 0;
+    unsigned int const shift = delta - (64 * base);
+    size_t lo[BITCPY_LANE_WORDS];
+    size_t hi[BITCPY_LANE_WORDS];
+    uint64_t mask[BITCPY_LANE_WORDS];
+    for (size_t w = 0; w < words; w++) {
+        long const first = (long) w + base;
+        lo[w] = (size_t) std::min((long) lastSource, std::max(0L, first));
+        hi[w] = (size_t) std::min((long) lastSource, std::max(0L, first + 1));
+        size_t const low = std::max((size_t) dstOffset, w * 64) - (w * 64);
+        size_t const high = std::min(dstOffset + bits, (w + 1) * 64) - (w * 64);
+        mask[w] = (high - low == 64) ? ~((uint64_t) 0) : ((((uint64_t) 1 << (high - low)) - 1) << low);
+    }
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m128i const right = _mm_cvtsi32_si128(shift);
+    // a shift by 64 clears the lane, so shift 0 needs no special case
+    __m128i const left = _mm_cvtsi32_si128(64 - shift);
+    __m256i const sourceIndex = _mm256_set_epi64x(3 * sourceWords, 2 * sourceWords, sourceWords, 0);
+    __m256i const targetIndex = _mm256_set_epi64x(3 * targetWords, 2 * targetWords, targetWords, 0);
+    alignas(32) uint64_t lanes[4];
+    for (; i + 4 <= count; i += 4) {
+        long long const *src = (long long const *) (source + (i * sourceWords));
+        uint64_t *dst = target + (i * targetWords);
+        for (size_t w = 0; w < words; w++) {
+            __m256i const low = _mm256_i64gather_epi64(src + lo[w], sourceIndex, 8);
+            __m256i const high = _mm256_i64gather_epi64(src + hi[w], sourceIndex, 8);
+            __m256i value = _mm256_or_si256(_mm256_srl_epi64(low, right), _mm256_sll_epi64(high, left));
+            if (mask[w] != ~((uint64_t) 0)) {
+                __m256i const keep = _mm256_set1_epi64x(mask[w]);
+                __m256i const old = _mm256_i64gather_epi64((long long const *) (dst + w), targetIndex, 8);
+                value = _mm256_or_si256(_mm256_and_si256(keep, value), _mm256_andnot_si256(keep, old));
+            }
+            _mm256_store_si256((__m256i *) lanes, value);
+            dst[w] = lanes[0];
+            dst[targetWords + w] = lanes[1];
+            dst[(2 * targetWords) + w] = lanes[2];
+            dst[(3 * targetWords) + w] = lanes[3];
+        }
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    // vshlq_u64 shifts right for negative counts
+    int64x2_t const right = vdupq_n_s64(-((int64_t) shift));
+    int64x2_t const left = vdupq_n_s64(64 - shift);
+    // the upper word does not contribute without a shift
+    uint64x2_t const upper = vdupq_n_u64(shift ? ~((uint64_t) 0) : 0);
+    for (; i + 2 <= count; i += 2) {
+        uint64_t const *src0 = source + (i * sourceWords);
+        uint64_t const *src1 = src0 + sourceWords;
+        uint64_t *dst0 = target + (i * targetWords);
+        uint64_t *dst1 = dst0 + targetWords;
+        for (size_t w = 0; w < words; w++) {
+            uint64x2_t const low = vcombine_u64(vld1_u64(src0 + lo[w]), vld1_u64(src1 + lo[w]));
+            uint64x2_t const high = vandq_u64(vcombine_u64(vld1_u64(src0 + hi[w]), vld1_u64(src1 + hi[w])), upper);
+            uint64x2_t value = vorrq_u64(vshlq_u64(low, right), vshlq_u64(high, left));
+            if (mask[w] != ~((uint64_t) 0)) {
+                uint64x2_t const old = vcombine_u64(vld1_u64(dst0 + w), vld1_u64(dst1 + w));
+                value = vbslq_u64(vdupq_n_u64(mask[w]), value, old);
+            }
+            vst1q_lane_u64(dst0 + w, value, 0);
+            vst1q_lane_u64(dst1 + w, value, 1);
+        }
+    }
+#endif
+    return i;
+}
+
+/**
+ * copies one element, offsets have to be normalized to 0..63
+ */
+void OffloadUtils::_bitcpy(char *target, size_t dstOffset, char *source, size_t srcOffset, size_t bits) {
     // Handle dstOffset
     if (dstOffset > 0) {
         uint64_t const offsetCorrection = (64 - dstOffset);
@@ -127,7 +671,7 @@ void OffloadUtils::bitcpy(char *target, size_t dstOffset, char *source, size_t s
     size_t const byteCopy = (srcOffset) ? 0 : ((bits / 64) * 8);
     size_t const bitsCopy = (srcOffset) ? bits : (bits % 64);
     if (byteCopy) {
-        OffloadUtils::memcpy(target, source, byteCopy);
+        OffloadUtils::deviceMemcpy(target, source, byteCopy);
         // debug_info("<memcpy> copied %lu bytes\n", byteCopy);
     }
     if (!bitsCopy)
@@ -137,18 +681,14 @@ void OffloadUtils::bitcpy(char *target, size_t dstOffset, char *source, size_t s
     uint64_t *source64 = (uint64_t *) (source + byteCopy);
     size_t const rounds = (bitsCopy / 64);
     size_t const bitsLeft = (bitsCopy % 64);
-    uint64_t src = source64[0];
     // if (rounds > 0) {
     //     debug_info("<mainloop> copy %lu rounds of 64 bits with srcOffset of %lu\n", rounds, srcOffset);
     // }
-    for (size_t r = 0; r < rounds; r++) {
-        uint64_t nxt = source64[r+1];
-        target64[r] = (src >> srcOffset) | (nxt << (64 - srcOffset));
-        src = nxt;
-    }
+    OffloadUtils::_funnelShift(target64, source64, srcOffset, rounds);
     if (!bitsLeft)
         return;
 
+    uint64_t src = source64[rounds];
     uint64_t dst = target64[rounds] >> bitsLeft << bitsLeft;
     if (bitsLeft > (64 - srcOffset)) {
         // debug_info("<bitsleft><nxt> copy left over %lu bits\n", bitsLeft);
@@ -160,14 +700,70 @@ void OffloadUtils::bitcpy(char *target, size_t dstOffset, char *source, size_t s
     }
 }
 
-void OffloadUtils::concatBuffer(ExtMemWord *targetBuffer, ExtMemWord *channelOutput, Layers::Layer const &layer, unsigned int const concatIndex) {
-    unsigned int const activationBits = layer.network.getActivationBits();
-    unsigned int const maxIFMCh = layer.network.getMaxIFMCh();
+/**
+ * funnel shift of whole words, target[r] gets the 64 bits starting at bit
+ * shift of source[r], vectorized with AVX2 or NEON if the compiler targets it
+ * @param target words to write
+ * @param source words to read, rounds + 1 words are read
+ * @param shift  bit offset in source, 1..63
+ * @param rounds words to write
+ */
+void OffloadUtils::_funnelShift(uint64_t *target, uint64_t const *source, unsigned int shift, size_t rounds) {
+    size_t r = 0;
+#if defined(__AVX2__)
+    __m128i const right = _mm_cvtsi32_si128(shift);
+    __m128i const left = _mm_cvtsi32_si128(64 - shift);
+    for (; r + 4 <= rounds; r += 4) {
+        __m256i const src = _mm256_loadu_si256((__m256i const *) &source[r]);
+        __m256i const nxt = _mm256_loadu_si256((__m256i const *) &source[r + 1]);
+        _mm256_storeu_si256((__m256i *) &target[r], _mm256_or_si256(_mm256_srl_epi64(src, right), _mm256_sll_epi64(nxt, left)));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    // vshlq_u64 shifts right for negative counts
+    int64x2_t const right = vdupq_n_s64(-((int64_t) shift));
+    int64x2_t const left = vdupq_n_s64(64 - shift);
+    for (; r + 2 <= rounds; r += 2) {
+        uint64x2_t const src = vld1q_u64(&source[r]);
+        uint64x2_t const nxt = vld1q_u64(&source[r + 1]);
+        vst1q_u64(&target[r], vorrq_u64(vshlq_u64(src, right), vshlq_u64(nxt, left)));
+    }
+#endif
+    for (; r < rounds; r++) {
+        target[r] = (source[r] >> shift) | (source[r + 1] << (64 - shift));
+    }
+}
+
+template <unsigned int ActivationBits, unsigned int MaxIFMCh, unsigned int Datawidth>
+constexpr unsigned int NetworkConstants<ActivationBits, MaxIFMCh, Datawidth>::activationBits;
+template <unsigned int ActivationBits, unsigned int MaxIFMCh, unsigned int Datawidth>
+constexpr unsigned int NetworkConstants<ActivationBits, MaxIFMCh, Datawidth>::maxIFMCh;
+template <unsigned int ActivationBits, unsigned int MaxIFMCh, unsigned int Datawidth>
+constexpr unsigned int NetworkConstants<ActivationBits, MaxIFMCh, Datawidth>::datawidth;
+
+template <typename Constants>
+bool OffloadUtils::_matches(Network::Descriptor const &network) {
+    return network.activationBits == Constants::activationBits &&
+        network.maxIFMCh == Constants::maxIFMCh &&
+        network.datawidth == Constants::datawidth;
+}
+
+template <typename Parameters>
+void OffloadUtils::_concatBuffer(Parameters const &network, ExtMemWord *targetBuffer, ExtMemWord *channelOutput, Layers::Layer const &layer, unsigned int const concatIndex) {
+    unsigned int const activationBits = network.activationBits;
     unsigned int const outBitSize = activationBits * layer.OFMCh;
-    unsigned int const maxIFMSize = GeneralUtils::padTo(std::ceil((float)(activationBits * maxIFMCh) / 8), apintPadding);
-    for (unsigned int i = 0; i < layer.outDim * layer.outDim; i++) {
-        unsigned int const offset = maxIFMSize * i;
-        OffloadUtils::bitcpy(&((char *)targetBuffer)[offset], concatIndex * outBitSize,  &((char *)channelOutput)[offset], 0, outBitSize);
+    // the iterations are laid out like the concatenated result
+    unsigned int const stride = layer.outStride;
+    OffloadUtils::bitcpy((char *) targetBuffer, stride, concatIndex * outBitSize, (char *) channelOutput, stride, 0, outBitSize, layer.outDim * layer.outDim);
+}
+
+void OffloadUtils::concatBuffer(ExtMemWord *targetBuffer, ExtMemWord *channelOutput, Layers::Layer const &layer, unsigned int const concatIndex) {
+    Network::Descriptor const &network = layer.network.getDescriptor();
+    if (OffloadUtils::_matches<W1A2Constants>(network)) {
+        OffloadUtils::_concatBuffer(W1A2Constants(), targetBuffer, channelOutput, layer, concatIndex);
+    } else if (OffloadUtils::_matches<W1A3Constants>(network)) {
+        OffloadUtils::_concatBuffer(W1A3Constants(), targetBuffer, channelOutput, layer, concatIndex);
+    } else {
+        OffloadUtils::_concatBuffer(network, targetBuffer, channelOutput, layer, concatIndex);
     }
 }
 
@@ -176,20 +772,31 @@ void OffloadUtils::concat(OffloadAdapter::ExtMemBuffer &targetBuffer, OffloadAda
     OffloadUtils::concatBuffer(targetBuffer.buffer, buffer.buffer, layer, concatIndex);
 }
 
-void OffloadUtils::splitBuffer(ExtMemWord *splitBuffer, ExtMemWord *buffer, Layers::Layer const &layer, unsigned int splitIndex) {
-    unsigned int const activationBits = layer.network.getActivationBits();
-    unsigned int const maxIFMCh = layer.network.getMaxIFMCh();
-    unsigned int const maxIFMSize = GeneralUtils::padTo((activationBits * maxIFMCh) / 8, apintPadding);
+template <typename Parameters>
+void OffloadUtils::_splitBuffer(Parameters const &network, ExtMemWord *splitBuffer, ExtMemWord *buffer, Layers::Layer const &layer, unsigned int splitIndex) {
+    unsigned int const activationBits = network.activationBits;
+    unsigned int const inStride = layer.inStride;
+    unsigned int const outStride = layer.outStride;
     unsigned int const outBits = activationBits * layer.outCh;
     unsigned int const clearOffset = (outBits / 8);//(outBits / 8);//(outBits / 8) - ((outBits / 8) % 8);
-    unsigned int const clearBytes = (maxIFMSize - clearOffset);
+    unsigned int const clearBytes = (outStride - clearOffset);
     unsigned int const bitOffset = splitIndex * outBits;
-    for (unsigned int i = 0; i < layer.inDim * layer.inDim; i++) {
-        if (clearOffset) {
-            OffloadUtils::memset(&((char *) splitBuffer)[(i*maxIFMSize) + clearOffset] , 0, clearBytes);
+    if (clearOffset && clearBytes) {
+        for (unsigned int i = 0; i < layer.inDim * layer.inDim; i++) {
+            OffloadUtils::deviceMemset(&((char *) splitBuffer)[(i*outStride) + clearOffset] , 0, clearBytes);
         }
-        OffloadUtils::bitcpy( &((char *) splitBuffer)[i*maxIFMSize], 0,  &((char *) buffer)[i*maxIFMSize], bitOffset, outBits);
-        // debug_info("For split %u, copy %u bytes from %p to %p\n",splitIndex, outSize, &((char *) buffer.buffer)[(i*maxIFMSize) + (splitIndex * outSize)], &((char *) splitBuffer.buffer)[(i*maxIFMSize)]);
+    }
+    OffloadUtils::bitcpy((char *) splitBuffer, outStride, 0, (char *) buffer, inStride, bitOffset, outBits, layer.inDim * layer.inDim);
+}
+
+void OffloadUtils::splitBuffer(ExtMemWord *splitBuffer, ExtMemWord *buffer, Layers::Layer const &layer, unsigned int splitIndex) {
+    Network::Descriptor const &network = layer.network.getDescriptor();
+    if (OffloadUtils::_matches<W1A2Constants>(network)) {
+        OffloadUtils::_splitBuffer(W1A2Constants(), splitBuffer, buffer, layer, splitIndex);
+    } else if (OffloadUtils::_matches<W1A3Constants>(network)) {
+        OffloadUtils::_splitBuffer(W1A3Constants(), splitBuffer, buffer, layer, splitIndex);
+    } else {
+        OffloadUtils::_splitBuffer(network, splitBuffer, buffer, layer, splitIndex);
     }
 }
 
@@ -198,18 +805,84 @@ void OffloadUtils::split(OffloadAdapter::ExtMemBuffer &targetBuffer, OffloadAdap
     OffloadUtils::splitBuffer(targetBuffer.buffer, buffer.buffer, layer, splitIndex);
 }
 
-void OffloadUtils::mergeBuffer(ExtMemWord *targetbuffer, ExtMemWord *buffer, Layers::Layer const &layer, unsigned int mergeIndex) {
-    unsigned int const activationBits = layer.network.getActivationBits();
-    unsigned int const maxIFMCh = layer.network.getMaxIFMCh();
-    unsigned int const maxIFMSize = GeneralUtils::padTo(std::ceil((float)(activationBits * maxIFMCh) / 8), apintPadding);
+/**
+ * fused split, every source pixel is read once and written to all split
+ * buffers, the row range allows to split one image in parallel
+ */
+template <typename Parameters>
+void OffloadUtils::_splitAllBuffer(Parameters const &network, ExtMemWord **splitBuffers, ExtMemWord *buffer, Layers::Layer const &layer, unsigned int firstRow, unsigned int lastRow) {
+    unsigned int const activationBits = network.activationBits;
+    unsigned int const inStride = layer.inStride;
+    unsigned int const outStride = layer.outStride;
+    unsigned int const outBits = activationBits * layer.outCh;
+    unsigned int const clearOffset = (outBits / 8);
+    unsigned int const clearBytes = (outStride - clearOffset);
+    for (unsigned int i = firstRow * layer.inDim; i < lastRow * layer.inDim; i++) {
+        char *source = &((char *) buffer)[i*inStride];
+        for (unsigned int s = 0; s < layer.split; s++) {
+            char *target = &((char *) splitBuffers[s])[i*outStride];
+            if (clearOffset && clearBytes) {
+                OffloadUtils::deviceMemset(target + clearOffset, 0, clearBytes);
+            }
+            OffloadUtils::bitcpy(target, 0, source, s * outBits, outBits);
+        }
+    }
+}
+
+void OffloadUtils::splitAllBuffer(ExtMemWord **splitBuffers, ExtMemWord *buffer, Layers::Layer const &layer, unsigned int firstRow, unsigned int lastRow) {
+    Network::Descriptor const &network = layer.network.getDescriptor();
+    if (OffloadUtils::_matches<W1A2Constants>(network)) {
+        OffloadUtils::_splitAllBuffer(W1A2Constants(), splitBuffers, buffer, layer, firstRow, lastRow);
+    } else if (OffloadUtils::_matches<W1A3Constants>(network)) {
+        OffloadUtils::_splitAllBuffer(W1A3Constants(), splitBuffers, buffer, layer, firstRow, lastRow);
+    } else {
+        OffloadUtils::_splitAllBuffer(network, splitBuffers, buffer, layer, firstRow, lastRow);
+    }
+}
+
+/**
+ * splits the rows firstRow to lastRow of buffer into all split buffers
+ * @param splitBuffers one target per split, at least layer.split
+ * @param buffer       source buffer
+ * @param layer        split layer
+ * @param firstRow     first pixel row to split
+ * @param lastRow      row after the last row to split
+ */
+void OffloadUtils::splitAll(std::vector<OffloadAdapter::BufferView> const &splitBuffers, OffloadAdapter::ExtMemBuffer &buffer, Layers::Layer const &layer, unsigned int firstRow, unsigned int lastRow) {
+    // do not lock the targets, row ranges are split parallel
+    std::vector<ExtMemWord *> targets(layer.split);
+    for (unsigned int s = 0; s < layer.split; s++) {
+        targets[s] = splitBuffers[s]->buffer;
+    }
+    OffloadUtils::splitAllBuffer(targets.data(), buffer.buffer, layer, firstRow, lastRow);
+}
+
+template <typename Parameters>
+void OffloadUtils::_mergeBuffer(Parameters const &network, ExtMemWord *targetbuffer, ExtMemWord *buffer, Layers::Layer const &layer, unsigned int mergeIndex) {
+    unsigned int const activationBits = network.activationBits;
+    unsigned int const inStride = layer.inStride;
+    unsigned int const outStride = layer.outStride;
     unsigned int const inBits = activationBits * layer.inCh;
     unsigned int const clearOffset = (inBits % 64 == 0) ? 0 : (mergeIndex + 1) * (inBits / 8);
-    for (unsigned int i = 0; i < layer.inDim * layer.inDim; i++) {
-        if (clearOffset) {
-            //If we copy not 8 byte aligned, we have to zero out the last 8 byte
-            OffloadUtils::memset(&((char *) targetbuffer)[(i*maxIFMSize) + clearOffset], 0, 8);
+    // compact pixels can end less than 8 bytes behind the group
+    unsigned int const clearBytes = (clearOffset < outStride) ? std::min(8u, outStride - clearOffset) : 0;
+    if (clearOffset && clearBytes) {
+        //If we copy not 8 byte aligned, we have to zero out the last 8 byte
+        for (unsigned int i = 0; i < layer.inDim * layer.inDim; i++) {
+            OffloadUtils::deviceMemset(&((char *) targetbuffer)[(i*outStride) + clearOffset], 0, clearBytes);
         }
-        OffloadUtils::bitcpy(&((char *) targetbuffer)[i*maxIFMSize], mergeIndex * inBits, &((char *) buffer)[i*maxIFMSize], 0 , inBits);
+    }
+    OffloadUtils::bitcpy((char *) targetbuffer, outStride, mergeIndex * inBits, (char *) buffer, inStride, 0, inBits, layer.inDim * layer.inDim);
+}
+
+void OffloadUtils::mergeBuffer(ExtMemWord *targetbuffer, ExtMemWord *buffer, Layers::Layer const &layer, unsigned int mergeIndex) {
+    Network::Descriptor const &network = layer.network.getDescriptor();
+    if (OffloadUtils::_matches<W1A2Constants>(network)) {
+        OffloadUtils::_mergeBuffer(W1A2Constants(), targetbuffer, buffer, layer, mergeIndex);
+    } else if (OffloadUtils::_matches<W1A3Constants>(network)) {
+        OffloadUtils::_mergeBuffer(W1A3Constants(), targetbuffer, buffer, layer, mergeIndex);
+    } else {
+        OffloadUtils::_mergeBuffer(network, targetbuffer, buffer, layer, mergeIndex);
     }
 }
 
@@ -220,7 +893,12 @@ void OffloadUtils::merge(OffloadAdapter::ExtMemBuffer &targetBuffer, OffloadAdap
 
 void OffloadUtils::memcpy(OffloadAdapter::ExtMemBuffer &targetBuffer, OffloadAdapter::ExtMemBuffer &buffer, size_t size) {
     std::unique_lock<std::mutex> l1(targetBuffer.lock);
-    OffloadUtils::memcpy((char *) targetBuffer.buffer,(char *) buffer.buffer, size);
+    OffloadUtils::deviceMemcpy((char *) targetBuffer.buffer, (char const *) buffer.buffer, size);
+}
+
+void OffloadUtils::memcpy(OffloadAdapter::ExtMemBuffer &targetBuffer, OffloadAdapter::ExtMemBuffer &buffer, size_t size, Jobber &jobber, bool const threading) {
+    std::unique_lock<std::mutex> l1(targetBuffer.lock);
+    OffloadUtils::parallelMemcpy((char *) targetBuffer.buffer, (char const *) buffer.buffer, size, jobber, threading);
 }
 
 void OffloadUtils::swap(OffloadAdapter::ExtMemBuffer &targetBuffer, OffloadAdapter::ExtMemBuffer &buffer) {
@@ -236,6 +914,14 @@ void OffloadUtils::swpcpy(OffloadAdapter::ExtMemBuffer &targetBuffer, OffloadAda
     }
 }
 
+void OffloadUtils::swpcpy(OffloadAdapter::ExtMemBuffer &targetBuffer, OffloadAdapter::ExtMemBuffer &buffer, size_t size, Jobber &jobber, bool const threading) {
+    if (buffer.isLocal()) {
+        OffloadUtils::memcpy(targetBuffer, buffer, size, jobber, threading);
+    } else {
+        OffloadUtils::swap(targetBuffer, buffer);
+    }
+}
+
 
 
 bool OffloadUtils::equal(char *buf1, size_t const sizeBuf1, char* buf2, size_t const sizeBuf2) {
@@ -250,28 +936,105 @@ bool OffloadUtils::equal(char *buf1, size_t const sizeBuf1, char* buf2, size_t c
     return true;
 }
 
-bool OffloadUtils::verifyBuffers(ExtMemWord *goldenBuffer, ExtMemWord *verifyBuffer, Network &network, unsigned int const outCh, unsigned int const outDim, Logger &output) {
-    unsigned int const activationBits = network.getActivationBits();
-    unsigned int const maxIFMCh = network.getMaxIFMCh();
-    unsigned int const datawidth = network.getDatawidth();
+/**
+ * compares the used channels of every pixel word wise, the bit errors are
+ * counted with popcount. Only words with errors are looked at bit by bit
+ * for the channel and bit position histograms. Keeps no state, so
+ * verifications can run in parallel
+ */
+template <typename Parameters>
+OffloadUtils::Verification OffloadUtils::_verify(Parameters const &network, ExtMemWord const *goldenBuffer, ExtMemWord const *verifyBuffer, unsigned int const outCh, unsigned int const outDim, size_t const stride) {
+    unsigned int const activationBits = network.activationBits;
+    unsigned int const maxIFMCh = network.maxIFMCh;
+    size_t const pixelBytes = (stride != 0) ? stride : (activationBits * maxIFMCh) / 8;
+    size_t const bits = activationBits * outCh;
+    size_t const words = bits / 64;
+    size_t const tailBytes = ((bits % 64) + 7) / 8;
+    uint64_t const tailMask = (bits % 64) ? (((uint64_t) 1) << (bits % 64)) - 1 : 0;
+    char const *golden = (char const *) goldenBuffer;
+    char const *verify = (char const *) verifyBuffer;
+    OffloadUtils::Verification result;
+    result.pixels = (unsigned long long) outDim * outDim;
+    result.pixelErrors.assign(result.pixels, 0);
+    result.channelErrors.assign(outCh, 0);
+    result.bitErrors.assign(activationBits, 0);
+    for (size_t i = 0; i < result.pixels; i++) {
+        char const *goldenPixel = golden + (i * pixelBytes);
+        char const *verifyPixel = verify + (i * pixelBytes);
+        unsigned int pixelErrors = 0;
+        // channels can span two words
+        unsigned int lastChannel = outCh;
+        for (size_t w = 0; w <= words; w++) {
+            uint64_t a = 0;
+            uint64_t b = 0;
+            if (w < words) {
+                std::memcpy(&a, goldenPixel + (w * 8), 8);
+                std::memcpy(&b, verifyPixel + (w * 8), 8);
+            } else if (tailMask) {
+                std::memcpy(&a, goldenPixel + (w * 8), tailBytes);
+                std::memcpy(&b, verifyPixel + (w * 8), tailBytes);
+            }
+            uint64_t diff = (a ^ b) & ((w < words) ? ~((uint64_t) 0) : tailMask);
+            if (!diff) {
+                continue;
+            }
+            pixelErrors += __builtin_popcountll(diff);
+            while (diff) {
+                unsigned int const bit = (w * 64) + __builtin_ctzll(diff);
+                unsigned int const channel = bit / activationBits;
+                result.bitErrors[bit % activationBits]++;
+                if (channel != lastChannel) {
+                    result.channelErrors[channel]++;
+                    result.wrongChannels++;
+                    lastChannel = channel;
+                }
+                diff &= diff - 1;
+            }
+        }
+        result.pixelErrors[i] = pixelErrors;
+        result.wrongBits += pixelErrors;
+        result.wrongPixels += (pixelErrors) ? 1 : 0;
+    }
+    return result;
+}
+
+/**
+ * verifies an output buffer against the golden output
+ * @param goldenBuffer expected output
+ * @param verifyBuffer output to verify
+ * @param network      network the output was computed with
+ * @param outCh        channels per pixel
+ * @param outDim       output dimension
+ * @param stride       bytes per pixel of both buffers, 0 for MAX_IFM_CH channels
+ * @return bit error statistics
+ */
+OffloadUtils::Verification OffloadUtils::verify(ExtMemWord const *goldenBuffer, ExtMemWord const *verifyBuffer, Network &network, unsigned int const outCh, unsigned int const outDim, size_t const stride) {
+    Network::Descriptor const &descriptor = network.getDescriptor();
+    if (OffloadUtils::_matches<W1A2Constants>(descriptor)) {
+        return OffloadUtils::_verify(W1A2Constants(), goldenBuffer, verifyBuffer, outCh, outDim, stride);
+    } else if (OffloadUtils::_matches<W1A3Constants>(descriptor)) {
+        return OffloadUtils::_verify(W1A3Constants(), goldenBuffer, verifyBuffer, outCh, outDim, stride);
+    } else {
+        return OffloadUtils::_verify(descriptor, goldenBuffer, verifyBuffer, outCh, outDim, stride);
+    }
+}
+
+template <typename Parameters>
+bool OffloadUtils::_verifyBuffers(Parameters const &network, ExtMemWord *goldenBuffer, ExtMemWord *verifyBuffer, unsigned int const outCh, unsigned int const outDim, Logger &output) {
+    unsigned int const activationBits = network.activationBits;
+    unsigned int const maxIFMCh = network.maxIFMCh;
+    unsigned int const datawidth = network.datawidth;
     unsigned int const maxIFMSize = (activationBits * maxIFMCh) / 8;
     unsigned int const outSize = (activationBits * outCh) / 8;
     char *golden = (char *) goldenBuffer;
     char *verify = (char *) verifyBuffer;
-    bool result = true;
-    unsigned long long wrongBytes = 0;
-    OffloadUtils::_wrongPixels = 0;
+    OffloadUtils::Verification const verification = OffloadUtils::_verify(network, goldenBuffer, verifyBuffer, outCh, outDim, 0);
+    OffloadUtils::_wrongPixels = verification.wrongPixels;
+    if (verification.correct() || !output.active()) {
+        return verification.correct();
+    }
     for (unsigned int i = 0; i < outDim * outDim; i++){
-        bool failed = false;
-        for (unsigned int b = 0; b < outSize; b++) {
-            if (golden[(i*maxIFMSize)+b] != verify[(i*maxIFMSize)+b]) {
-                wrongBytes++;
-                result = false;
-                failed = true;
-            }
-        }
-        OffloadUtils::_wrongPixels += (failed) ? 1 : 0;
-        if (failed && output.active()) {
+        if (verification.pixelErrors[i] > 0) {
             output << "golden[" << i << "] ^ verify[" << i << "]:" << std::endl;
             for (unsigned int b = 0; b < outSize; b++) {
                 if (golden[(i*maxIFMSize)+b] != verify[(i*maxIFMSize)+b]) {
@@ -283,24 +1046,31 @@ bool OffloadUtils::verifyBuffers(ExtMemWord *goldenBuffer, ExtMemWord *verifyBuf
             output << std::endl << std::endl;
         }
     }
-    return result;
+    return false;
 }
 
-unsigned long long OffloadUtils::tellPixels() {
-    return OffloadUtils::_wrongPixels;
+bool OffloadUtils::verifyBuffers(ExtMemWord *goldenBuffer, ExtMemWord *verifyBuffer, Network &network, unsigned int const outCh, unsigned int const outDim, Logger &output) {
+    Network::Descriptor const &descriptor = network.getDescriptor();
+    if (OffloadUtils::_matches<W1A2Constants>(descriptor)) {
+        return OffloadUtils::_verifyBuffers(W1A2Constants(), goldenBuffer, verifyBuffer, outCh, outDim, output);
+    } else if (OffloadUtils::_matches<W1A3Constants>(descriptor)) {
+        return OffloadUtils::_verifyBuffers(W1A3Constants(), goldenBuffer, verifyBuffer, outCh, outDim, output);
+    } else {
+        return OffloadUtils::_verifyBuffers(descriptor, goldenBuffer, verifyBuffer, outCh, outDim, output);
+    }
 }
 
-bool OffloadUtils::down(OffloadAdapter::ExtMemBuffer &targetBuffer) {
-    std::unique_lock<std::mutex> l(targetBuffer.lock);
-    bool result = targetBuffer.down();
-    l.unlock();
-    if (result) {
-        targetBuffer.cond.notify_all();
-    }
-    return result;
+unsigned long long OffloadUtils::tellPixels() {
+    return OffloadUtils::_wrongPixels;
 }
 
-void waitOrWork(Jobber &jobber, OffloadAdapter::ExtMemBuffer &buffer) {
+/**
+ * Waits until the buffer has no pending writers, meanwhile queued jobs are
+ * processed, so a waiting job cannot starve the jobs it is waiting for
+ * @param jobber job pool to help out
+ * @param buffer buffer to wait for
+ */
+void OffloadUtils::waitOrWork(Jobber &jobber, OffloadAdapter::ExtMemBuffer &buffer) {
     while (buffer.isPending()) {
         if (!jobber.work()) {
             buffer.waitPending();
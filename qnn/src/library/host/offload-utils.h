@@ -32,6 +32,7 @@
 #ifndef OFFLOAD_UTILS_H_
 #define OFFLOAD_UTILS_H_
 
+#include <algorithm>
 #include <bitset>
 #include <sys/wait.h>
 #include <sys/types.h>
@@ -48,39 +49,147 @@
 #include "logger.h"
 #include "jobber.h"
 
+// bytes per chunk of the parallel buffer copies, copies below two chunks stay on the calling thread
+#define PARALLEL_COPY_CHUNK (64 * 1024)
+
+// elements of a strided bitcpy spanning up to this many target words are
+// copied several at once, one element per vector lane
+#define BITCPY_LANE_WORDS 8
 
 #define DEBUG 1
 #include "debug.h"
 
+/**
+ * compile time parameters of a known network, the buffer kernels take them
+ * in place of a Network::Descriptor, so strides and sizes become constants
+ */
+template <unsigned int ActivationBits, unsigned int MaxIFMCh, unsigned int Datawidth>
+struct NetworkConstants {
+    static constexpr unsigned int activationBits = ActivationBits;
+    static constexpr unsigned int maxIFMCh = MaxIFMCh;
+    static constexpr unsigned int datawidth = Datawidth;
+};
+
+typedef NetworkConstants<2, 384, 64> W1A2Constants;
+typedef NetworkConstants<3, 512, 64> W1A3Constants;
+
 class OffloadUtils {
+    public:
+        /**
+         * layout conversion of OffloadUtils::padTo, computed once per pair of
+         * buffer sizes. Rows are runs of rowElements elements starting on a
+         * 64 bit boundary of the output, so they can be converted in parallel
+         */
+        struct PadPlan {
+            PadPlan() : outputSize(0), inputSize(0), elements(0), outputBits(0),
+            inputBits(0), copyBits(0), rowElements(1), bytes(false) {};
+            size_t outputSize;
+            size_t inputSize;
+            unsigned int elements;
+            unsigned int outputBits;
+            unsigned int inputBits;
+            unsigned int copyBits;
+            unsigned int rowElements;
+            //elements and copied bits are whole bytes, rows are plain copies
+            bool bytes;
+
+            bool matches(size_t const output, size_t const input, unsigned int const count) const {
+                return this->outputSize == output && this->inputSize == input && this->elements == count;
+            }
+        };
+
+        /**
+         * result of OffloadUtils::verify, bit errors between the golden and
+         * the verified output with their distribution over the pixels, the
+         * channels and the bit positions inside an activation
+         */
+        struct Verification {
+            Verification() : pixels(0), wrongPixels(0), wrongChannels(0), wrongBits(0) {};
+            unsigned long long pixels;
+            unsigned long long wrongPixels;
+            unsigned long long wrongChannels;
+            unsigned long long wrongBits;
+            //bit errors of every pixel
+            std::vector<unsigned int> pixelErrors;
+            //wrong activations of every channel, summed over all pixels
+            std::vector<unsigned int> channelErrors;
+            //bit errors of every bit position inside an activation
+            std::vector<unsigned long long> bitErrors;
+
+            bool correct() const {
+                return this->wrongBits == 0;
+            }
+        };
+
     private:
         OffloadUtils() {};
         ~OffloadUtils() {};
 
         static unsigned long long _wrongPixels;
+        static size_t _copyChunk;
+
+        static void _parallel(size_t const, std::function<void(size_t, size_t)> const &, Jobber &, bool const);
+
+        // GeneralUtils::padTo the compiler can see through
+        static constexpr unsigned int _padTo(unsigned int num, unsigned int padTo) {
+            return ((num + padTo - 1) / padTo) * padTo;
+        }
+        template <typename Constants>
+        static bool _matches(Network::Descriptor const &);
+        static void _bitcpy(char *, size_t, char *, size_t, size_t);
+        static void _funnelShift(uint64_t *, uint64_t const *, unsigned int, size_t);
+        static size_t _bitcpyLanes(uint64_t *, size_t, unsigned int, uint64_t const *, size_t, unsigned int, size_t, size_t);
+        static uint64_t _loadBytes(char const *, size_t const);
+        static void _storeBytes(char *, uint64_t, size_t);
+        static void _streamWords(uint64_t *, uint64_t const *, size_t const);
+        static void _streamFill(uint64_t *, uint64_t const, size_t const);
+        template <typename Parameters>
+        static void _concatBuffer(Parameters const &, ExtMemWord *, ExtMemWord *, Layers::Layer const &, unsigned int const);
+        template <typename Parameters>
+        static void _splitBuffer(Parameters const &, ExtMemWord *, ExtMemWord *, Layers::Layer const &, unsigned int);
+        template <typename Parameters>
+        static void _splitAllBuffer(Parameters const &, ExtMemWord **, ExtMemWord *, Layers::Layer const &, unsigned int, unsigned int);
+        template <typename Parameters>
+        static void _mergeBuffer(Parameters const &, ExtMemWord *, ExtMemWord *, Layers::Layer const &, unsigned int);
+        template <typename Parameters>
+        static bool _verifyBuffers(Parameters const &, ExtMemWord *, ExtMemWord *, unsigned int const, unsigned int const, Logger &);
+        template <typename Parameters>
+        static OffloadUtils::Verification _verify(Parameters const &, ExtMemWord const *, ExtMemWord const *, unsigned int const, unsigned int const, size_t const);
     public:
 
         static void padTo(char *, size_t const, char *, size_t const, unsigned int const);
-
-
-
-        static bool down(OffloadAdapter::ExtMemBuffer &targetBuffer);
+        static OffloadUtils::PadPlan padPlan(size_t const, size_t const, unsigned int const);
+        static void padTo(OffloadUtils::PadPlan const &, char *, char *, unsigned int const, unsigned int const);
+        static void padTo(OffloadUtils::PadPlan const &, char *, char *, Jobber &, bool const);
 
         static void memcpy(char *, char *, size_t);
         static void memset(char *, char, size_t);
         static void memset(ExtMemWord *to, char val, size_t const size);
+        static void deviceMemcpy(char *, char const *, size_t);
+        static void deviceMemset(char *, char const, size_t);
+        static void setCopyChunk(size_t const);
+        static void parallelMemcpy(char *, char const *, size_t const, Jobber &, bool const);
+        static void parallelMemset(char *, char const, size_t const, Jobber &, bool const);
         static void bitcpy(char *, size_t, char *, size_t, size_t);
+        static void bitcpy(char *, size_t, size_t, char *, size_t, size_t, size_t, size_t);
         static void concatBuffer(ExtMemWord *, ExtMemWord *, Layers::Layer const &, unsigned int const);
         static void concat(OffloadAdapter::ExtMemBuffer &, OffloadAdapter::ExtMemBuffer &, Layers::Layer const &, unsigned int );
         static void splitBuffer(ExtMemWord *, ExtMemWord *, Layers::Layer const &, unsigned int);
         static void split(OffloadAdapter::ExtMemBuffer &, OffloadAdapter::ExtMemBuffer &, Layers::Layer const &, unsigned int);
+        static void splitAllBuffer(ExtMemWord **, ExtMemWord *, Layers::Layer const &, unsigned int, unsigned int);
+        static void splitAll(std::vector<OffloadAdapter::BufferView> const &, OffloadAdapter::ExtMemBuffer &, Layers::Layer const &, unsigned int, unsigned int);
         static void mergeBuffer(ExtMemWord *, ExtMemWord *, Layers::Layer const &, unsigned int );
         static void merge(OffloadAdapter::ExtMemBuffer &, OffloadAdapter::ExtMemBuffer &, Layers::Layer const &, unsigned int );
         static void memcpy(OffloadAdapter::ExtMemBuffer &, OffloadAdapter::ExtMemBuffer &, size_t);
         static void swap(OffloadAdapter::ExtMemBuffer &, OffloadAdapter::ExtMemBuffer &);
         static void swpcpy(OffloadAdapter::ExtMemBuffer &, OffloadAdapter::ExtMemBuffer &, size_t);
+        static void memcpy(OffloadAdapter::ExtMemBuffer &, OffloadAdapter::ExtMemBuffer &, size_t, Jobber &, bool const);
+        static void swpcpy(OffloadAdapter::ExtMemBuffer &, OffloadAdapter::ExtMemBuffer &, size_t, Jobber &, bool const);
         static bool equal(char *, size_t const, char*, size_t const);
         static bool verifyBuffers(ExtMemWord *, ExtMemWord *, Network &, unsigned int const, unsigned int const, Logger &);
+        static OffloadUtils::Verification verify(ExtMemWord const *, ExtMemWord const *, Network &, unsigned int const, unsigned int const, size_t const = 0);
+        static void packActivations(char *, size_t const, unsigned char const *, size_t const, unsigned int const, unsigned int const, unsigned int const);
+        static void unpackActivations(float *, char const *, size_t const, unsigned int const, unsigned int const, unsigned int const);
         static unsigned long long tellPixels();
         static void waitOrWork(Jobber &jobber, OffloadAdapter::ExtMemBuffer &buffer);
         /*
@@ -0,0 +1,168 @@
+/*
+    Copyright (c) 2018, Xilinx, Inc.
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1.  Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+    2.  Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+    3.  Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+    THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+    PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+    CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+    EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+    PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+    OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+    OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+    ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "weight-pack.h"
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+WeightPack::WeightPack(std::string const &path) : _path(path), _map(MAP_FAILED), _mapSize(0), _header(NULL), _blocks(NULL) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open weight pack " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(WeightPack::Header)) {
+        close(fd);
+        throw std::runtime_error("Weight pack " + path + " is too small");
+    }
+    this->_mapSize = info.st_size;
+    this->_map = mmap(NULL, this->_mapSize, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (this->_map == MAP_FAILED) {
+        throw std::runtime_error("Could not map weight pack " + path);
+    }
+    // the blocks are copied front to back exactly once
+    madvise(this->_map, this->_mapSize, MADV_SEQUENTIAL);
+
+    this->_header = (WeightPack::Header const *) this->_map;
+    this->_blocks = (WeightPack::Block const *) (this->_header + 1);
+    size_t const indexEnd = sizeof(WeightPack::Header) + ((size_t) this->_header->rows * this->_header->channels * sizeof(WeightPack::Block));
+    if (std::memcmp(this->_header->magic, WEIGHTPACK_MAGIC, sizeof(this->_header->magic)) != 0 ||
+        this->_header->version != WEIGHTPACK_VERSION ||
+        this->_header->channels == 0 ||
+        indexEnd > this->_mapSize) {
+        munmap(this->_map, this->_mapSize);
+        throw std::runtime_error("Weight pack " + path + " is invalid or of an unsupported version");
+    }
+    for (unsigned int i = 0; i < this->_header->rows * this->_header->channels; i++) {
+        if (this->_blocks[i].offset < indexEnd || this->_blocks[i].offset + this->_blocks[i].size > this->_mapSize) {
+            munmap(this->_map, this->_mapSize);
+            throw std::runtime_error("Weight pack " + path + " is truncated");
+        }
+    }
+}
+
+WeightPack::~WeightPack() {
+    if (this->_map != MAP_FAILED) {
+        munmap(this->_map, this->_mapSize);
+    }
+}
+
+unsigned int WeightPack::first() const {
+    return this->_header->first;
+}
+
+unsigned int WeightPack::rows() const {
+    return this->_header->rows;
+}
+
+unsigned int WeightPack::channels() const {
+    return this->_header->channels;
+}
+
+unsigned long long WeightPack::key() const {
+    return this->_header->key;
+}
+
+bool WeightPack::contains(unsigned int fileIndex) const {
+    return fileIndex >= this->_header->first && fileIndex < this->_header->first + this->_header->rows;
+}
+
+WeightPack::Block const &WeightPack::_block(unsigned int fileIndex, unsigned int channel) const {
+    if (!this->contains(fileIndex) || channel >= this->_header->channels) {
+        throw std::out_of_range("Weight pack " + this->_path + " has no block " + std::to_string(fileIndex) + "-" + std::to_string(channel));
+    }
+    return this->_blocks[((fileIndex - this->_header->first) * this->_header->channels) + channel];
+}
+
+void const *WeightPack::data(unsigned int fileIndex, unsigned int channel) const {
+    return (char const *) this->_map + this->_block(fileIndex, channel).offset;
+}
+
+size_t WeightPack::size(unsigned int fileIndex, unsigned int channel) const {
+    return this->_block(fileIndex, channel).size;
+}
+
+/**
+ * writes all loaded blocks of a weight table into a new weight pack
+ * @param path  target file, gets truncated
+ * @param table loaded weight table
+ * @param first binparam file index of the first table row
+ * @param key   stored in the header
+ */
+void WeightPack::write(std::string const &path, WeightTable const &table, unsigned int first, unsigned long long key) {
+    WeightPack::Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, WEIGHTPACK_MAGIC, sizeof(header.magic));
+    header.version = WEIGHTPACK_VERSION;
+    header.alignment = WEIGHTPACK_ALIGNMENT;
+    header.first = first;
+    header.rows = table.size();
+    header.channels = table.channels();
+    header.key = key;
+
+    std::vector<WeightPack::Block> blocks(header.rows * header.channels);
+    uint64_t offset = sizeof(header) + (blocks.size() * sizeof(WeightPack::Block));
+    for (unsigned int row = 0; row < header.rows; row++) {
+        for (unsigned int channel = 0; channel < header.channels; channel++) {
+            WeightPack::Block &block = blocks[(row * header.channels) + channel];
+            offset = ((offset + WEIGHTPACK_ALIGNMENT - 1) / WEIGHTPACK_ALIGNMENT) * WEIGHTPACK_ALIGNMENT;
+            block.offset = offset;
+            block.size = table.at(row, channel).size;
+            offset += block.size;
+        }
+    }
+
+    std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open " + path + " for writing");
+    }
+    file.write((char const *) &header, sizeof(header));
+    file.write((char const *) blocks.data(), blocks.size() * sizeof(WeightPack::Block));
+    for (unsigned int i = 0; i < blocks.size(); i++) {
+        WeightTable::Entry const &entry = table.at(i / header.channels, i % header.channels);
+        if (entry.size > 0 && !entry.buffer) {
+            throw std::runtime_error("Weight block " + std::to_string(first + (i / header.channels)) + "-" + std::to_string(i % header.channels) + " is not loaded");
+        }
+        // pad up to the aligned block start
+        file.seekp(blocks[i].offset);
+        file.write((char const *) entry.buffer, entry.size);
+    }
+    if (!file.good()) {
+        throw std::runtime_error("Could not write weight pack " + path);
+    }
+    file.close();
+}
@@ -0,0 +1,102 @@
+/*
+    Copyright (c) 2018, Xilinx, Inc.
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1.  Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+    2.  Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+    3.  Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+    THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+    PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+    CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+    EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+    PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+    OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+    OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+    ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef WEIGHT_PACK_H_
+#define WEIGHT_PACK_H_
+
+#include <string>
+#include <stdexcept>
+#include <stdint.h>
+#include "weight-table.h"
+
+#define WEIGHTPACK_MAGIC        "QNNWPACK"
+#define WEIGHTPACK_VERSION      1
+#define WEIGHTPACK_ALIGNMENT    4096
+
+/**
+ * Single file container of all weight and threshold blocks of a network.
+ * Every block is stored exactly as it is laid out in the weight memory of
+ * the accelerator, so loading is one copy per block from the mapped file
+ * instead of reading hundreds of small binparam files word by word.
+ *
+ * Layout:
+ *  Header
+ *  Block index, rows * channels entries, row major
+ *  Blocks, each one aligned to WEIGHTPACK_ALIGNMENT
+ *
+ * Row r holds the blocks of binparam file index (first + r). The key is
+ * free for the creator, the weight cache stores the hash of the network,
+ * layers and binparams the blocks were prepared from
+ */
+class WeightPack {
+    public:
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t alignment;
+            uint32_t first;
+            uint32_t rows;
+            uint32_t channels;
+            uint32_t reserved;
+            uint64_t key;
+        };
+
+        struct Block {
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        WeightPack(std::string const &path);
+        ~WeightPack();
+
+        unsigned int first() const;
+        unsigned int rows() const;
+        unsigned int channels() const;
+        unsigned long long key() const;
+        bool contains(unsigned int fileIndex) const;
+        void const *data(unsigned int fileIndex, unsigned int channel) const;
+        size_t size(unsigned int fileIndex, unsigned int channel) const;
+
+        static void write(std::string const &path, WeightTable const &table, unsigned int first, unsigned long long key = 0);
+    private:
+        WeightPack(WeightPack const &) = delete;
+        WeightPack &operator=(WeightPack const &) = delete;
+
+        Block const &_block(unsigned int fileIndex, unsigned int channel) const;
+
+        std::string _path;
+        void *_map;
+        size_t _mapSize;
+        Header const *_header;
+        Block const *_blocks;
+};
+
+#endif
@@ -0,0 +1,115 @@
+/*
+    Copyright (c) 2018, Xilinx, Inc.
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1.  Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+    2.  Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+    3.  Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+    THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+    PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+    CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+    EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+    PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+    OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+    OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+    ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef WEIGHT_TABLE_H_
+#define WEIGHT_TABLE_H_
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include "platform.h"
+
+/**
+ * Flat, index addressed table of the weight buffers of all layers. Every
+ * weight index (layer, iteration and split) owns one row with an entry for
+ * every memory channel, so a lookup is a single multiplication instead of a
+ * list walk. The physical addresses are resolved when the row is filled and
+ * can be written to the hardware registers directly.
+ */
+class WeightTable {
+    public:
+        struct Entry {
+            Entry() : buffer(NULL), phys(0), size(0) {};
+            ExtMemWord *buffer;
+            unsigned long long phys;
+            size_t size;
+        };
+
+        WeightTable(unsigned int channels = 1) : _channels(channels) {
+            if (this->_channels == 0) {
+                throw std::runtime_error("Weight table needs at least one memory channel!");
+            }
+        };
+
+        /**
+         * appends a new empty row for the next weight index
+         * @return index of the new row
+         */
+        unsigned int add() {
+            this->_entries.resize(this->_entries.size() + this->_channels);
+            return this->size() - 1;
+        }
+
+        Entry &at(unsigned int index, unsigned int channel) {
+            return this->_entries[(index * this->_channels) + channel];
+        }
+
+        Entry const &at(unsigned int index, unsigned int channel) const {
+            return this->_entries[(index * this->_channels) + channel];
+        }
+
+        /**
+         * returns the row of the given weight index, the row holds one entry
+         * per memory channel
+         */
+        Entry const *row(unsigned int index) const {
+            if (index >= this->size()) {
+                throw std::out_of_range("Weight index " + std::to_string(index) + " is not loaded!");
+            }
+            return &this->_entries[index * this->_channels];
+        }
+
+        unsigned int size() const {
+            return this->_entries.size() / this->_channels;
+        }
+
+        unsigned int channels() const {
+            return this->_channels;
+        }
+
+        void clear() {
+            this->_entries.clear();
+        }
+
+        std::vector<Entry>::iterator begin() {
+            return this->_entries.begin();
+        }
+
+        std::vector<Entry>::iterator end() {
+            return this->_entries.end();
+        }
+
+    private:
+        unsigned int _channels;
+        std::vector<Entry> _entries;
+};
+
+#endif
@@ -0,0 +1,135 @@
+/*
+    Copyright (c) 2018, Xilinx, Inc.
+    All rights reserved.
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+    1.  Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+    2.  Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+    3.  Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+    THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+    PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+    CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+    EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+    PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+    OR BUSINESS INTERRUPTION). HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+    OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+    ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Randomized check of the strided OffloadUtils::bitcpy against a bit by bit
+ * reference. Every case runs the batch call, which takes the vector lanes
+ * for narrow elements, and single element calls, which stay scalar.
+ * usage: test_bitcpy.elf [cases] [seed]
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "offload-utils.h"
+
+namespace {
+    struct Case {
+        size_t targetStride;
+        size_t dstOffset;
+        size_t sourceStride;
+        size_t srcOffset;
+        size_t bits;
+        size_t count;
+    };
+
+    bool getBit(std::vector<uint64_t> const &buffer, size_t bit) {
+        return (buffer[bit / 64] >> (bit % 64)) & 1;
+    }
+
+    void setBit(std::vector<uint64_t> &buffer, size_t bit, bool value) {
+        uint64_t const mask = (uint64_t) 1 << (bit % 64);
+        buffer[bit / 64] = value ? (buffer[bit / 64] | mask) : (buffer[bit / 64] & ~mask);
+    }
+
+    void referenceBitcpy(std::vector<uint64_t> &target, std::vector<uint64_t> const &source, Case const &c) {
+        for (size_t i = 0; i < c.count; i++) {
+            for (size_t b = 0; b < c.bits; b++) {
+                setBit(target, (i * c.targetStride * 8) + c.dstOffset + b, getBit(source, (i * c.sourceStride * 8) + c.srcOffset + b));
+            }
+        }
+    }
+
+    Case randomCase(std::mt19937_64 &random) {
+        Case c;
+        // mostly narrow elements as in the split and merge kernels
+        bool const narrow = (random() % 4) != 0;
+        c.bits = 1 + (random() % (narrow ? 256 : 1024));
+        c.dstOffset = random() % 512;
+        c.srcOffset = random() % 512;
+        c.count = 1 + (random() % 40);
+        // strides are whole words, some with spare words between elements
+        c.targetStride = (((c.dstOffset + c.bits + 63) / 64) + (random() % 3)) * 8;
+        c.sourceStride = (((c.srcOffset + c.bits + 63) / 64) + (random() % 3)) * 8;
+        return c;
+    }
+
+    bool check(std::vector<uint64_t> const &result, std::vector<uint64_t> const &expected, Case const &c, char const *variant) {
+        for (size_t w = 0; w < expected.size(); w++) {
+            if (result[w] != expected[w]) {
+                std::cerr << variant << " bitcpy differs in word " << w << ": bits " << c.bits << " count " << c.count
+                    << " dstOffset " << c.dstOffset << " targetStride " << c.targetStride
+                    << " srcOffset " << c.srcOffset << " sourceStride " << c.sourceStride << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned long const cases = (argc > 1) ? std::strtoul(argv[1], NULL, 10) : 20000;
+    unsigned long const seed = (argc > 2) ? std::strtoul(argv[2], NULL, 10) : 1;
+    std::mt19937_64 random(seed);
+    for (unsigned long n = 0; n < cases; n++) {
+        Case const c = randomCase(random);
+        // one spare word behind both buffers catches writes past the end
+        std::vector<uint64_t> source(((c.sourceStride * c.count) / 8) + 1);
+        std::vector<uint64_t> initial(((c.targetStride * c.count) / 8) + 1);
+        for (auto &word : source) {
+            word = random();
+        }
+        for (auto &word : initial) {
+            word = random();
+        }
+        std::vector<uint64_t> expected(initial);
+        referenceBitcpy(expected, source, c);
+
+        std::vector<uint64_t> batch(initial);
+        OffloadUtils::bitcpy((char *) batch.data(), c.targetStride, c.dstOffset, (char *) source.data(), c.sourceStride, c.srcOffset, c.bits, c.count);
+        if (!check(batch, expected, c, "Batch")) {
+            return 1;
+        }
+
+        std::vector<uint64_t> single(initial);
+        for (size_t i = 0; i < c.count; i++) {
+            OffloadUtils::bitcpy((char *) single.data() + (i * c.targetStride), c.dstOffset, (char *) source.data() + (i * c.sourceStride), c.srcOffset, c.bits);
+        }
+        if (!check(single, expected, c, "Single")) {
+            return 1;
+        }
+    }
+    std::cout << "bitcpy matches the reference in " << cases << " cases (seed " << seed << ")" << std::endl;
+    return 0;
+}
@@ -71,6 +71,11 @@
 
 
 #define MEM_CHANNELS            2
+// banks of the conv weight memory, the second bank takes the weights of
+// the next layer while the current layer computes
+#ifndef WEIGHT_BANKS
+#define WEIGHT_BANKS            1
+#endif
 
 #define INPUT_BITS              8
 #define ACTIVATION_BITS         2
@@ -71,6 +71,11 @@
 
 
 #define MEM_CHANNELS        2
+// banks of the conv weight memory, the second bank takes the weights of
+// the next layer while the current layer computes
+#ifndef WEIGHT_BANKS
+#define WEIGHT_BANKS        1
+#endif
 
 #define ACTIVATION_BITS     3
 #define WEIGHTS_BITS        1
@@ -36,6 +36,18 @@
 
 static ap_uint<MAX_SIMD> convWeightMem[MAX_PE_CONV][MAX_CONV_WMEM];
 static ap_uint<THRESHOLDS_BITS> convThresMem[MAX_PE_CONV][MAX_CONV_TMEM];
+#if WEIGHT_BANKS > 1
+// shadow bank, filled while computing and copied over on commit
+static ap_uint<MAX_SIMD> convWeightMemNext[MAX_PE_CONV][MAX_CONV_WMEM];
+static ap_uint<THRESHOLDS_BITS> convThresMemNext[MAX_PE_CONV][MAX_CONV_TMEM];
+#endif
+
+/**
+ * lets the software adapter know if the shadow bank was compiled in
+ */
+unsigned int WeightBanks() {
+    return WEIGHT_BANKS;
+}
 
 unsigned int paddedSizeHW(unsigned int in, unsigned int padTo) {
     if(in % padTo == 0)
@@ -44,8 +56,13 @@ unsigned int paddedSizeHW(unsigned int in, unsigned int padTo) {
         return in + padTo - (in % padTo);
 }
 
-void StreamingDoMemInit(ap_uint<DATAWIDTH> *in1, ap_uint<DATAWIDTH> *in2, const short unsigned int KernelDim) {
+void StreamingDoMemInit(ap_uint<DATAWIDTH> *in1, ap_uint<DATAWIDTH> *in2, const short unsigned int KernelDim,
+        const unsigned int IFMCh, const unsigned int OFMCh, const unsigned int Groups,
+        ap_uint<MAX_SIMD> weightMem[MAX_PE_CONV][MAX_CONV_WMEM],
+        ap_uint<THRESHOLDS_BITS> thresMem[MAX_PE_CONV][MAX_CONV_TMEM]) {
 #pragma HLS DATAFLOW
+#pragma HLS ARRAY_PARTITION variable=weightMem complete dim=1
+#pragma HLS ARRAY_PARTITION variable=thresMem complete dim=1
 
     hls::stream<ap_uint<DATAWIDTH> > streamIn1("streamInMem1");
     hls::stream<ap_uint<DATAWIDTH> > streamIn2("streamInMem2");
@@ -53,8 +70,16 @@ void StreamingDoMemInit(ap_uint<DATAWIDTH> *in1, ap_uint<DATAWIDTH> *in2, const
 #pragma HLS STREAM variable=streamIn1 depth=16
 #pragma HLS STREAM variable=streamIn2 depth=16
 
-    const unsigned int convWMemWidth = ((KernelDim*KernelDim * MAX_OFM_CH * MAX_IFM_CH) / (MAX_PE_CONV * MAX_SIMD));
-    const unsigned int convTMemWidth = 2 * MAX_OFM_CH / MAX_PE_CONV;
+    // only the weights of the layer shape are streamed, a grouped layer holds
+    // the columns of one group per neuron fold. Without channels the whole
+    // memory is streamed
+    const unsigned int paddedIFMCh = (IFMCh == 0) ? MAX_IFM_CH : paddedSizeHW(IFMCh, MAX_SIMD);
+    const unsigned int paddedOFMCh = (IFMCh == 0) ? MAX_OFM_CH : paddedSizeHW(OFMCh, MAX_PE_CONV);
+    const unsigned int groupIFMCh = (Groups > 1) ? paddedIFMCh / Groups : paddedIFMCh;
+
+    const unsigned int convWMemWidth = ((KernelDim*KernelDim * paddedOFMCh * groupIFMCh) / (MAX_PE_CONV * MAX_SIMD));
+    const unsigned int convTMemWidth = 2 * paddedOFMCh / MAX_PE_CONV;
+    const unsigned int convTMemCount = paddedOFMCh / MAX_PE_CONV;
     const unsigned int convMemBits = DATAWIDTH * MAX_PE_CONV * (convWMemWidth + convTMemWidth);
 
     Mem2Stream<DATAWIDTH, (CONV_MEM_BITS/MEM_CHANNELS) / 8> (in1, streamIn1, (convMemBits/MEM_CHANNELS) / 8);
@@ -62,54 +87,100 @@ void StreamingDoMemInit(ap_uint<DATAWIDTH> *in1, ap_uint<DATAWIDTH> *in2, const
     Mem2Stream<DATAWIDTH, (CONV_MEM_BITS/MEM_CHANNELS) / 8> (in2, streamIn2, (convMemBits/MEM_CHANNELS) / 8);
 
     StreamingInitMemory_Precision<DATAWIDTH, THRESHOLDS_BITS, MAX_SIMD, MAX_PE_CONV, 0, MAX_PE_CONV/2, MAX_CONV_WMEM, MAX_CONV_TMEM>
-            (streamIn1, convWeightMem, convThresMem, convWMemWidth, MAX_CONV_TMEM);
+            (streamIn1, weightMem, thresMem, convWMemWidth, convTMemCount);
 
     StreamingInitMemory_Precision<DATAWIDTH, THRESHOLDS_BITS, MAX_SIMD, MAX_PE_CONV, MAX_PE_CONV/2, MAX_PE_CONV, MAX_CONV_WMEM, MAX_CONV_TMEM>
-            (streamIn2, convWeightMem, convThresMem, convWMemWidth, MAX_CONV_TMEM);
+            (streamIn2, weightMem, thresMem, convWMemWidth, convTMemCount);
+}
+
+#if WEIGHT_BANKS > 1
+/**
+ * makes the shadow bank the active weight memory, all PEs are copied in
+ * parallel, which is much shorter than streaming the weights again
+ */
+void CommitWeightMem() {
+    for (unsigned int w = 0; w < MAX_CONV_WMEM; w++) {
+#pragma HLS PIPELINE II=1
+        for (unsigned int pe = 0; pe < MAX_PE_CONV; pe++) {
+#pragma HLS UNROLL
+            convWeightMem[pe][w] = convWeightMemNext[pe][w];
+        }
+    }
+    for (unsigned int t = 0; t < MAX_CONV_TMEM; t++) {
+#pragma HLS PIPELINE II=1
+        for (unsigned int pe = 0; pe < MAX_PE_CONV; pe++) {
+#pragma HLS UNROLL
+            convThresMem[pe][t] = convThresMemNext[pe][t];
+        }
+    }
 }
+#endif
 
-void DoCompute(ap_uint<DATAWIDTH> * in,	ap_uint<DATAWIDTH> * out,
+void DoCompute(ap_uint<DATAWIDTH> * in,	ap_uint<DATAWIDTH> * out, ap_uint<DATAWIDTH> * prev,
         const unsigned int KernelDim, const unsigned int Stride,
         const unsigned int IFMCh, const unsigned int OFMCh,
         const unsigned int IFMDim, const unsigned int PaddedDim,
         const unsigned int OFMDim, const unsigned int PoolInDim,
         const unsigned int PoolOutDim, const unsigned int PoolStride,
-        const ap_uint<1> enablePool) {
+        const ap_uint<1> enablePool, const unsigned int InChOffset,
+        const unsigned int OutChOffset, const ap_uint<1> enableSliceIn,
+        const ap_uint<1> enableSliceOut, const unsigned int Groups,
+        const unsigned int InWords, const unsigned int OutWords) {
 #pragma HLS DATAFLOW
 
     hls::stream<ap_uint<DATAWIDTH> > memInStream("memInStream");
+    hls::stream<ap_uint<ACTIVATION_BITS * MAX_IFM_CH> > convInStream("convInStream");
     hls::stream<ap_uint<ACTIVATION_BITS * MAX_IFM_CH> > convStream("convStream");
     hls::stream<ap_uint<ACTIVATION_BITS * MAX_OFM_CH> > poolStream("poolStream");
     hls::stream<ap_uint<ACTIVATION_BITS * MAX_OFM_CH> > poolPadStream("poolPadStream");
     hls::stream<ap_uint<ACTIVATION_BITS * MAX_OFM_CH> > netOutStream("netOutStream");
     hls::stream<ap_uint<ACTIVATION_BITS * MAX_IFM_CH> > netOutStream_padded("netOutStream_padded");
+    hls::stream<ap_uint<ACTIVATION_BITS * MAX_IFM_CH> > prevStream("prevStream");
+    hls::stream<ap_uint<ACTIVATION_BITS * MAX_IFM_CH> > sliceStream("sliceStream");
+    hls::stream<ap_uint<DATAWIDTH> > prevMemStream("prevMemStream");
     hls::stream<ap_uint<DATAWIDTH> > memOutStream("memOutStream");
 
 #pragma HLS STREAM variable=memInStream depth=1
+#pragma HLS STREAM variable=convInStream depth=1
 #pragma HLS STREAM variable=convStream depth=1
 #pragma HLS STREAM variable=poolStream depth=1
 #pragma HLS STREAM variable=poolPadStream depth=1
 #pragma HLS STREAM variable=netOutStream depth=1
+#pragma HLS STREAM variable=prevStream depth=1
+#pragma HLS STREAM variable=sliceStream depth=1
+#pragma HLS STREAM variable=prevMemStream depth=1
 #pragma HLS STREAM variable=memOutStream depth=1
 
 #pragma HLS RESOURCE variable=memInStream core=FIFO_LUTRAM
+#pragma HLS RESOURCE variable=convInStream core=FIFO_LUTRAM
 #pragma HLS RESOURCE variable=convStream core=FIFO_LUTRAM
 #pragma HLS RESOURCE variable=poolStream core=FIFO_LUTRAM
 #pragma HLS RESOURCE variable=poolPadStream core=FIFO_LUTRAM
 #pragma HLS RESOURCE variable=netOutStream core=FIFO_LUTRAM
+#pragma HLS RESOURCE variable=prevStream core=FIFO_LUTRAM
+#pragma HLS RESOURCE variable=sliceStream core=FIFO_LUTRAM
+#pragma HLS RESOURCE variable=prevMemStream core=FIFO_LUTRAM
 #pragma HLS RESOURCE variable=memOutStream core=FIFO_LUTRAM
 
-    const unsigned int inBits = ACTIVATION_BITS * IFMDim * IFMDim * MAX_IFM_CH;
-    const unsigned int outBits = ACTIVATION_BITS * PoolOutDim * PoolOutDim * MAX_IFM_CH;
+    // compact buffers hold InWords/OutWords memory words per pixel, the
+    // width converters expand them to the full channel width on chip
+    const unsigned int inPixelBits = (InWords != 0) ? InWords * DATAWIDTH : ACTIVATION_BITS * MAX_IFM_CH;
+    const unsigned int outPixelBits = (OutWords != 0) ? OutWords * DATAWIDTH : ACTIVATION_BITS * MAX_IFM_CH;
+    const unsigned int inBits = inPixelBits * IFMDim * IFMDim;
+    const unsigned int outBits = outPixelBits * PoolOutDim * PoolOutDim;
     const unsigned int paddedIFMCh = paddedSizeHW(IFMCh, MAX_SIMD);
     const unsigned int paddedOFMCh = paddedSizeHW(OFMCh, MAX_PE_CONV);
 
     Mem2Stream<DATAWIDTH, ACTIVATION_BITS*MAX_IFM_DIM*MAX_IFM_DIM*MAX_IFM_CH / 8> (in, memInStream, inBits / 8);
     StreamingDataWidthConverter<ACTIVATION_BITS*MAX_IFM_DIM*MAX_IFM_DIM*MAX_IFM_CH / DATAWIDTH, DATAWIDTH, ACTIVATION_BITS * MAX_IFM_CH>
-            (memInStream, convStream, inBits / DATAWIDTH, DATAWIDTH, ACTIVATION_BITS*MAX_IFM_CH);
+            (memInStream, convInStream, inBits / DATAWIDTH, DATAWIDTH, inPixelBits);
+
+    // grouped layers read their channel group from the shared input buffer
+    StreamSelectChannels<MAX_IFM_CH, ACTIVATION_BITS>
+            (convInStream, convStream, IFMDim * IFMDim, InChOffset, IFMCh, enableSliceIn);
     //logStringStream<ACTIVATION_BITS * MAX_IFM_CH>("conv1_in_loopback.txt",convStream);
     StreamingConvLayer_Precision_SIMD_faster <MAX_K,MAX_IFM_CH,MAX_IFM_DIM,MAX_OFM_CH,MAX_OFM_DIM,MAX_SIMD,MAX_PE_CONV,WEIGHTS_BITS,THRESHOLDS_BITS,ACTIVATION_BITS,ACTIVATION_BITS,MACC_BITS,MAX_CONV_WMEM,MAX_CONV_TMEM,FULL_THRESHOLDS>
-            (convStream, poolStream, convWeightMem, convThresMem, KernelDim, IFMCh, paddedIFMCh, paddedOFMCh, IFMDim, PaddedDim, OFMDim, Stride);
+            (convStream, poolStream, convWeightMem, convThresMem, KernelDim, IFMCh, paddedIFMCh, paddedOFMCh, IFMDim, PaddedDim, OFMDim, Stride, Groups);
     //logStringStream<ACTIVATION_BITS * MAX_OFM_CH>("conv1_out_loopback.txt",poolStream);
     StreamPad<ACTIVATION_BITS * MAX_OFM_CH> (poolStream, poolPadStream, OFMDim, PoolInDim);
 
@@ -117,19 +188,62 @@ void DoCompute(ap_uint<DATAWIDTH> * in,	ap_uint<DATAWIDTH> * out,
             (poolPadStream, netOutStream, PoolInDim, PoolOutDim, MAX_POOL_SIZE, PoolStride, enablePool);
     //logStringStream<ACTIVATION_BITS * MAX_OFM_CH>("pool1_out_loopback.txt",netOutStream);
     StreamPadChannels<ACTIVATION_BITS * MAX_OFM_CH, ACTIVATION_BITS * MAX_IFM_CH>(netOutStream, netOutStream_padded, PoolOutDim*PoolOutDim);
+    // grouped layers write their channel group into the shared output
+    // buffer, the other groups are read back from it through hostmem2,
+    // the first group starts from zeros
+    Mem2StreamOptional<DATAWIDTH, ACTIVATION_BITS*MAX_OFM_DIM*MAX_OFM_DIM*MAX_IFM_CH / 8> (prev, prevMemStream, outBits / 8, enableSliceOut && (OutChOffset != 0));
+
+    StreamingDataWidthConverter<ACTIVATION_BITS*MAX_OFM_DIM*MAX_OFM_DIM*MAX_IFM_CH / DATAWIDTH, DATAWIDTH, ACTIVATION_BITS * MAX_IFM_CH>
+            (prevMemStream, prevStream, outBits / DATAWIDTH, DATAWIDTH, outPixelBits);
+
+    StreamInsertChannels<MAX_IFM_CH, ACTIVATION_BITS>
+            (netOutStream_padded, prevStream, sliceStream, PoolOutDim * PoolOutDim, OutChOffset, OFMCh, enableSliceOut);
+
     StreamingDataWidthConverter<MAX_OFM_DIM*MAX_OFM_DIM, ACTIVATION_BITS * MAX_IFM_CH, DATAWIDTH>
-            (netOutStream_padded, memOutStream, PoolOutDim*PoolOutDim, ACTIVATION_BITS * MAX_IFM_CH, DATAWIDTH);
+            (sliceStream, memOutStream, PoolOutDim * PoolOutDim, outPixelBits, DATAWIDTH);
 
     Stream2Mem<DATAWIDTH, ACTIVATION_BITS*MAX_OFM_DIM*MAX_OFM_DIM*MAX_IFM_CH / 8> (memOutStream, out, outBits / 8);
 }
 
+#if WEIGHT_BANKS > 1
+/**
+ * computes a layer with the active weights while the weights of the next
+ * layer stream into the shadow bank
+ */
+void DoComputePrefetch(ap_uint<DATAWIDTH> * in, ap_uint<DATAWIDTH> * out, ap_uint<DATAWIDTH> * prev,
+        const unsigned int KernelDim, const unsigned int Stride,
+        const unsigned int IFMCh, const unsigned int OFMCh,
+        const unsigned int IFMDim, const unsigned int PaddedDim,
+        const unsigned int OFMDim, const unsigned int PoolInDim,
+        const unsigned int PoolOutDim, const unsigned int PoolStride,
+        const ap_uint<1> enablePool, const unsigned int InChOffset,
+        const unsigned int OutChOffset, const ap_uint<1> enableSliceIn,
+        const ap_uint<1> enableSliceOut, const unsigned int Groups,
+        const unsigned int InWords, const unsigned int OutWords,
+        ap_uint<DATAWIDTH> * next1, ap_uint<DATAWIDTH> * next2,
+        const unsigned int NextKernelDim, const unsigned int NextIFMCh,
+        const unsigned int NextOFMCh, const unsigned int NextGroups) {
+#pragma HLS DATAFLOW
+    DoCompute(in, out, prev, KernelDim, Stride, IFMCh, OFMCh, IFMDim, PaddedDim, OFMDim, PoolInDim, PoolOutDim, PoolStride, enablePool, InChOffset, OutChOffset, enableSliceIn, enableSliceOut, Groups, InWords, OutWords);
+    StreamingDoMemInit(next1, next2, NextKernelDim, NextIFMCh, NextOFMCh, NextGroups, convWeightMemNext, convThresMemNext);
+}
+#endif
+
 void BlackBoxJam(ap_uint<64> * in1, ap_uint<64> * in2, ap_uint<64> * out,
         bool doInit, unsigned int layerType,
         const unsigned int KernelDim, const unsigned int Stride,
         const unsigned int IFMCh, const unsigned int OFMCh,
         const unsigned int IFMDim, const unsigned int PaddedDim,
         const unsigned int OFMDim, const unsigned int PoolInDim,
-        const unsigned int PoolOutDim, const unsigned int PoolStride)
+        const unsigned int PoolOutDim, const unsigned int PoolStride,
+        const unsigned int InChOffset, const unsigned int OutChOffset,
+        bool SliceIn, bool SliceOut, ap_uint<64> * prev,
+        const unsigned int Groups, const unsigned int InWords,
+        const unsigned int OutWords, const unsigned int NumImages,
+        ap_uint<64> * batch, bool Prefetch, bool Commit,
+        ap_uint<64> * next1, ap_uint<64> * next2,
+        const unsigned int NextKernelDim, const unsigned int NextIFMCh,
+        const unsigned int NextOFMCh, const unsigned int NextGroups)
 {
     // signals to be mapped to the AXI Lite slave port
 #pragma HLS INTERFACE s_axilite port=return bundle=control
@@ -145,6 +259,20 @@ void BlackBoxJam(ap_uint<64> * in1, ap_uint<64> * in2, ap_uint<64> * out,
 #pragma HLS INTERFACE s_axilite port=PoolInDim bundle=control
 #pragma HLS INTERFACE s_axilite port=PoolOutDim bundle=control
 #pragma HLS INTERFACE s_axilite port=PoolStride bundle=control
+#pragma HLS INTERFACE s_axilite port=InChOffset bundle=control
+#pragma HLS INTERFACE s_axilite port=OutChOffset bundle=control
+#pragma HLS INTERFACE s_axilite port=SliceIn bundle=control
+#pragma HLS INTERFACE s_axilite port=SliceOut bundle=control
+#pragma HLS INTERFACE s_axilite port=Groups bundle=control
+#pragma HLS INTERFACE s_axilite port=InWords bundle=control
+#pragma HLS INTERFACE s_axilite port=OutWords bundle=control
+#pragma HLS INTERFACE s_axilite port=NumImages bundle=control
+#pragma HLS INTERFACE s_axilite port=Prefetch bundle=control
+#pragma HLS INTERFACE s_axilite port=Commit bundle=control
+#pragma HLS INTERFACE s_axilite port=NextKernelDim bundle=control
+#pragma HLS INTERFACE s_axilite port=NextIFMCh bundle=control
+#pragma HLS INTERFACE s_axilite port=NextOFMCh bundle=control
+#pragma HLS INTERFACE s_axilite port=NextGroups bundle=control
     // signals to be mapped to the AXI master port (hostmem1, hostmem2)
 #pragma HLS INTERFACE m_axi offset=slave port=in1 bundle=hostmem1 depth=1
 #pragma HLS INTERFACE s_axilite port=in1 bundle=control
@@ -152,18 +280,63 @@ void BlackBoxJam(ap_uint<64> * in1, ap_uint<64> * in2, ap_uint<64> * out,
 #pragma HLS INTERFACE s_axilite port=out bundle=control
 #pragma HLS INTERFACE m_axi offset=slave port=in2 bundle=hostmem2 depth=1
 #pragma HLS INTERFACE s_axilite port=in2 bundle=control
+#pragma HLS INTERFACE m_axi offset=slave port=prev bundle=hostmem2 depth=1
+#pragma HLS INTERFACE s_axilite port=prev bundle=control
+#pragma HLS INTERFACE m_axi offset=slave port=batch bundle=hostmem2 depth=1
+#pragma HLS INTERFACE s_axilite port=batch bundle=control
+#pragma HLS INTERFACE m_axi offset=slave port=next1 bundle=hostmem1 depth=1
+#pragma HLS INTERFACE s_axilite port=next1 bundle=control
+#pragma HLS INTERFACE m_axi offset=slave port=next2 bundle=hostmem2 depth=1
+#pragma HLS INTERFACE s_axilite port=next2 bundle=control
     // partition PE arrays
 #pragma HLS ARRAY_PARTITION variable=convWeightMem complete dim=1
 #pragma HLS ARRAY_PARTITION variable=convThresMem complete dim=1
 #pragma HLS RESOURCE variable=convThresMem core=RAM_2P_LUTRAM
+#if WEIGHT_BANKS > 1
+#pragma HLS ARRAY_PARTITION variable=convWeightMemNext complete dim=1
+#pragma HLS ARRAY_PARTITION variable=convThresMemNext complete dim=1
+#pragma HLS RESOURCE variable=convThresMemNext core=RAM_2P_LUTRAM
+#endif
+
+    // an unset Groups register reads 0, which means no grouping
+    const unsigned int groups = (Groups > 1) ? Groups : 1;
+    const unsigned int nextGroups = (NextGroups > 1) ? NextGroups : 1;
 
     if (doInit) {
-        StreamingDoMemInit(in1, in2, KernelDim);
-    } else {
-        if (layerType == CONV_LAYER){
-            DoCompute(in1, out, KernelDim, Stride, IFMCh, OFMCh, IFMDim, PaddedDim, OFMDim, OFMDim, OFMDim, 0, 0);
+#if WEIGHT_BANKS > 1
+        if (Commit) {
+            CommitWeightMem();
         } else {
-            DoCompute(in1, out, KernelDim, Stride, IFMCh, OFMCh, IFMDim, PaddedDim, OFMDim, PoolInDim, PoolOutDim, PoolStride, 1);
+            StreamingDoMemInit(in1, in2, KernelDim, IFMCh, OFMCh, groups, convWeightMem, convThresMem);
+        }
+#else
+        // without a shadow bank there is nothing to commit
+        if (!Commit) {
+            StreamingDoMemInit(in1, in2, KernelDim, IFMCh, OFMCh, groups, convWeightMem, convThresMem);
+        }
+#endif
+    } else {
+        // a batch runs NumImages images with the resident weights, the
+        // batch table holds the word offsets of every input and output
+        // buffer to the first one. No images keeps the single image mode
+        const unsigned int images = (NumImages != 0) ? NumImages : 1;
+        // plain conv layers pass the conv output through the pool stage
+        const unsigned int poolInDim = (layerType == CONV_LAYER) ? OFMDim : PoolInDim;
+        const unsigned int poolOutDim = (layerType == CONV_LAYER) ? OFMDim : PoolOutDim;
+        const unsigned int poolStride = (layerType == CONV_LAYER) ? 0 : PoolStride;
+        const ap_uint<1> enablePool = (layerType == CONV_LAYER) ? 0 : 1;
+        for (unsigned int i = 0; i < images; i++) {
+            const long long inOffset = (NumImages != 0) ? (long long) batch[2 * i].to_int64() : 0;
+            const long long outOffset = (NumImages != 0) ? (long long) batch[(2 * i) + 1].to_int64() : 0;
+#if WEIGHT_BANKS > 1
+            // the next weights stream in once, along the first image
+            if (Prefetch && (i == 0)) {
+                DoComputePrefetch(in1 + inOffset, out + outOffset, prev + outOffset, KernelDim, Stride, IFMCh, OFMCh, IFMDim, PaddedDim, OFMDim, poolInDim, poolOutDim, poolStride, enablePool, InChOffset, OutChOffset, SliceIn, SliceOut, groups, InWords, OutWords,
+                        next1, next2, NextKernelDim, NextIFMCh, NextOFMCh, nextGroups);
+                continue;
+            }
+#endif
+            DoCompute(in1 + inOffset, out + outOffset, prev + outOffset, KernelDim, Stride, IFMCh, OFMCh, IFMDim, PaddedDim, OFMDim, poolInDim, poolOutDim, poolStride, enablePool, InChOffset, OutChOffset, SliceIn, SliceOut, groups, InWords, OutWords);
         }
     }
 }
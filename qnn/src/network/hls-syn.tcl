@@ -56,9 +56,16 @@ set config_toplevelfxn "BlackBoxJam"
 set config_proj_part [lindex $argv 5]
 set config_clkperiod [lindex $argv 6]
 
+# the ultra96 has the BRAM for a second weight bank, weights of the next
+# layer stream in while the current layer computes
+set config_hwflags ""
+if {$config_platform == "ultra96"} {
+    set config_hwflags "-DWEIGHT_BANKS=2"
+}
+
 # set up project
 open_project -reset $config_proj_name-$config_platform
-add_files $config_hwsrcdir/top.cpp -cflags "-std=c++0x -I$config_qnnlibdirhls"
+add_files $config_hwsrcdir/top.cpp -cflags "-std=c++0x -I$config_qnnlibdirhls $config_hwflags"
 add_files -tb $config_swsrcdir/main.cpp -cflags "-std=c++0x -DNOZIP -O3 -I$config_qnnlibdirdrv -I$config_qnnlibdirhls -I$config_qnnlibdirhost -I$config_hwsrcdir -I$config_jsondir"
 add_files -tb $config_qnnlibdirhost/general-utils.cpp -cflags "-std=c++0x -O3 -I$config_qnnlibdirdrv -I$config_qnnlibdirhls -I$config_qnnlibdirhost -I$config_hwsrcdir -I$config_jsondir"
 add_files -tb $config_qnnlibdirhost/offload-utils.cpp -cflags "-std=c++0x -O3 -I$config_qnnlibdirdrv -I$config_qnnlibdirhls -I$config_qnnlibdirhost -I$config_hwsrcdir -I$config_jsondir"
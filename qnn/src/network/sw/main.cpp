@@ -42,7 +42,10 @@
 #include <iomanip>
 #include <memory>
 #include <vector>
+#include <algorithm>
 #include <map>
+#include <mutex>
+#include <functional>
 #ifndef NOZIP
 #include <zip.h>
 #endif
@@ -50,6 +53,7 @@
 #include "general-utils.h"
 #include "offload-utils.h"
 #include "offload-adapter.h"
+#include "weight-pack.h"
 #include "jobber.h"
 #include "network.h"
 #include "layers.h"
@@ -70,6 +74,8 @@ extern "C" {
     void initAcceleratorZip(char const *zipPath);
 #endif
     void singleInference(char *in, size_t const inSize, char *out, size_t const outSize);
+    int packedInference(unsigned char const *in, unsigned int const inChannels, unsigned int const inDim, float *out, unsigned int const outChannels, unsigned int const outDim);
+    char const *getLastError();
     void deinitAccelerator();
 }
 
@@ -90,6 +96,11 @@ namespace {
     unsigned int batchSize = 1;
     unsigned int imageCount = 1;
     unsigned int threadCount = 0;
+    unsigned int localPages = LOCALBUFFER_PAGES_DEFAULT;
+    std::string weightCache;
+    OffloadAdapter::WeightReader weightReader;
+    unsigned int weightLoading = WEIGHTS_LOADING_EAGER;
+    unsigned int weightBudget = 0;
     bool verbose = false;
     bool threading = false;
     bool inputTiming = false;
@@ -99,11 +110,15 @@ namespace {
     std::unique_ptr<OffloadAdapter> adapter;
     std::unique_ptr<Jobber>         jobber;
 
-    std::vector<OffloadAdapter::ExtMemBuffer *> resultBuffers;
-    std::vector<OffloadAdapter::ExtMemBuffer *> concatBuffers;
-    std::vector<OffloadAdapter::ExtMemBuffer *> mergeBuffers;
-    std::vector<OffloadAdapter::ExtMemBuffer *> testBuffers;
-    std::vector<std::vector<OffloadAdapter::ExtMemBuffer *>> splitBuffers;
+    std::vector<OffloadAdapter::BufferView> resultBuffers;
+    std::vector<OffloadAdapter::BufferView> concatBuffers;
+    std::vector<OffloadAdapter::BufferView> mergeBuffers;
+    std::vector<OffloadAdapter::BufferView> testBuffers;
+    std::vector<std::vector<OffloadAdapter::BufferView>> splitBuffers;
+
+    // layout conversions of singleInference, kept for the next call with the same sizes
+    OffloadUtils::PadPlan inputPadPlan;
+    OffloadUtils::PadPlan outputPadPlan;
 
     Logger stdOut(std::cout, verbose);
     Logger stdErr(std::cerr, verbose);
@@ -111,8 +126,96 @@ namespace {
     Logger::Verbosity verboseNone(false);
 
     bool initialized = false;
+    // message of the last failed call returning an error code
+    std::string lastError;
+
+#ifndef NOZIP
+    // zip handles are not thread safe, every parallel reader takes its own
+    std::string zipPackage;
+    std::mutex zipLock;
+    std::vector<zip *> zipHandles;
+#endif
+
+
+}
+
+static bool toLocalPages(char const *from, unsigned int &to) {
+    std::string const pages(from);
+    if (pages == "default") {
+        to = LOCALBUFFER_PAGES_DEFAULT;
+    } else if (pages == "transparent") {
+        to = LOCALBUFFER_PAGES_TRANSPARENT;
+    } else if (pages == "explicit") {
+        to = LOCALBUFFER_PAGES_EXPLICIT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool toWeightLoading(char const *from, unsigned int &to) {
+    std::string const loading(from);
+    if (loading == "eager") {
+        to = WEIGHTS_LOADING_EAGER;
+    } else if (loading == "lazy") {
+        to = WEIGHTS_LOADING_LAZY;
+    } else if (loading == "prefetch") {
+        to = WEIGHTS_LOADING_PREFETCH;
+    } else {
+        return false;
+    }
+    return true;
+}
 
+/**
+ * parses a decimal number, signs and trailing characters are rejected
+ */
+static bool toUnsignedInt(char const *from, unsigned int &to) {
+    std::istringstream ss(from);
+    unsigned int test;
+    if (from[0] != '-' && (ss >> test) && ss.eof()) {
+        to = test;
+        return true;
+    }
+    return false;
+}
 
+/**
+ * reads the QNN_* environment variables, shared by the testbench and the
+ * library entry points so both accept the same values
+ * @param  error message naming the first invalid variable
+ * @return       false if a variable has an invalid value
+ */
+static bool readEnvironment(std::string &error) {
+    char const *env = getenv("QNN_LOCAL_PAGES");
+    if (env && !toLocalPages(env, localPages)) {
+        error = "Invalid QNN_LOCAL_PAGES value " + std::string(env);
+        return false;
+    }
+    env = getenv("QNN_WEIGHT_CACHE");
+    if (env) {
+        weightCache = env;
+    }
+    env = getenv("QNN_WEIGHT_LOADING");
+    if (env && !toWeightLoading(env, weightLoading)) {
+        error = "Invalid QNN_WEIGHT_LOADING value " + std::string(env);
+        return false;
+    }
+    env = getenv("QNN_WEIGHT_BUDGET");
+    if (env && !toUnsignedInt(env, weightBudget)) {
+        error = "Invalid QNN_WEIGHT_BUDGET value " + std::string(env);
+        return false;
+    }
+    env = getenv("QNN_COPY_CHUNK");
+    if (env) {
+        unsigned int copyChunk = 0;
+        if (!toUnsignedInt(env, copyChunk)) {
+            error = "Invalid QNN_COPY_CHUNK value " + std::string(env);
+            return false;
+        }
+        OffloadUtils::setCopyChunk((size_t) copyChunk * 1024);
+    }
+    return true;
 }
 
 void initParameters(unsigned int const batch, unsigned int const threads) {
@@ -121,6 +224,32 @@ void initParameters(unsigned int const batch, unsigned int const threads) {
 
     batchSize = (batch > 0) ? batch : 1;
     threadCount = threads;
+
+    std::string error;
+    if (!readEnvironment(error)) {
+        throw std::runtime_error(error);
+    }
+}
+
+/**
+ * buffer of a step slot for a batch image, the hardware slot takes a new
+ * buffer from the pool
+ * @param slot Layers::slot_* of the step
+ * @param k    batch image
+ */
+OffloadAdapter::BufferView slotBuffer(unsigned int const slot, unsigned int const k) {
+    switch (slot) {
+        case Layers::slot_split:
+            return splitBuffers[k][0];
+        case Layers::slot_concat:
+            return concatBuffers[k];
+        case Layers::slot_merge:
+            return mergeBuffers[k];
+        case Layers::slot_hardware:
+            return OffloadAdapter::BufferView(adapter->getBuffer(EXTMEMBUFFER_HARDWARE));
+        default:
+            return testBuffers[k];
+    }
 }
 
 void _init() {
@@ -128,18 +257,35 @@ void _init() {
 
     adapter.reset(new OffloadAdapter(layers->getNetwork(), network->getMemChannels(), layers->getMaxBufferSize()));
     jobber.reset(new Jobber(threadCount));
+    adapter->setLocalPages(localPages);
+    adapter->setWeightCache(weightCache);
+    adapter->setWeightReader(weightReader);
+    // budget is given in MiB
+    adapter->setWeightLoading(weightLoading, (size_t) weightBudget << 20);
 
     if (layers->useBinparams()) {
-        adapter->loadWeights(*network, *layers);
+        adapter->loadWeights(*network, *layers, *jobber);
     };
 
     unsigned int const maxIterations = layers->getMaxIterations();
     unsigned int const maxSplits = layers->getMaxSplit();
+    bool const channelSlice = network->hasChannelSlice() && (maxSplits > 1);
+    // multi iteration layers write their tiles into the concat buffers
+    bool const tileSlice = network->hasChannelSlice() && (maxIterations > 1);
+    // if every split is sliced, the split source is the only split buffer
+    bool splitSlices = channelSlice;
+    for (auto const &step : layers->getSteps()) {
+        if (layers->getLayer(step.layer).layer & Layers::split) {
+            splitSlices = splitSlices && step.sliceIn;
+        }
+    }
+    unsigned int const splitBufferCount = splitSlices ? 1 : maxSplits;
 
     // batchSize of hardware buffers for the inputs, 2 for output buffers
     // even a single threaded call tries to do work parallel to hardware
     // that needs at least one more output buffer to not block the applciation
-    unsigned int const minHardwareBuffers = batchSize + 2;
+    // batched offloads take the output buffers of all images at once
+    unsigned int const minHardwareBuffers = batchSize + (network->hasBatchOffload() ? batchSize + 1 : 2) + (channelSlice ? 2 * batchSize : 0) + (tileSlice ? batchSize : 0);
     unsigned int hardwareBufferCount = 0;
     stdOut << "Initializing a minimum of " << minHardwareBuffers << " hardware buffers of size " << adapter->getBufferSize() << " bytes..." << std::endl;
     // Threading is drastically improved through free hardware buffers
@@ -154,7 +300,9 @@ void _init() {
 
 
     unsigned int const minLocalBuffers = ((maxIterations > 1) ? batchSize : 0)
-        + ((maxSplits > 1) ? batchSize + (batchSize * maxSplits) : 0)
+        + ((maxSplits > 1) ? batchSize + (batchSize * splitBufferCount) : 0)
+        - (channelSlice ? 2 * batchSize : 0)
+        - (tileSlice ? batchSize : 0)
         + batchSize;
     unsigned int localBufferCount = 0;
     stdOut << "Initializing a minimum of " << minLocalBuffers << " local buffers of size " << adapter->getBufferSize() << " bytes..." << std::endl;
@@ -167,30 +315,32 @@ void _init() {
     //Concat buffers are only used for multi iterations
     concatBuffers.resize((maxIterations > 1) ? batchSize : 0);
     for (auto &buf : concatBuffers) {
-        buf = &adapter->getBuffer(EXTMEMBUFFER_LOCAL);
+        buf = adapter->getBuffer(tileSlice ? EXTMEMBUFFER_HARDWARE : EXTMEMBUFFER_LOCAL);
     }
 
+    // with channel slices the hardware writes the merge buffers and reads
+    // the split source from the first split buffer
     mergeBuffers.resize((maxSplits > 1) ? batchSize : 0);
     for (auto &buf : mergeBuffers) {
-        buf = &adapter->getBuffer(EXTMEMBUFFER_LOCAL);
+        buf = adapter->getBuffer(channelSlice ? EXTMEMBUFFER_HARDWARE : EXTMEMBUFFER_LOCAL);
     }
 
     resultBuffers.resize(batchSize);
     for (auto &buf : resultBuffers) {
-        buf = &adapter->getBuffer(EXTMEMBUFFER_LOCAL);
+        buf = adapter->getBuffer(EXTMEMBUFFER_LOCAL);
     }
 
     splitBuffers.resize(batchSize);
     for (auto &buffers : splitBuffers) {
-        buffers.resize(maxSplits);
-        for (auto &buf: buffers) {
-            buf = &adapter->getBuffer(EXTMEMBUFFER_LOCAL);
+        buffers.resize(splitBufferCount);
+        for (unsigned int s = 0; s < buffers.size(); s++) {
+            buffers[s] = adapter->getBuffer((channelSlice && s == 0) ? EXTMEMBUFFER_HARDWARE : EXTMEMBUFFER_LOCAL);
         }
     }
 
     testBuffers.resize(batchSize);
     for (auto &buf : testBuffers) {
-        buf = &adapter->getBuffer(EXTMEMBUFFER_HARDWARE);
+        buf = adapter->getBuffer(EXTMEMBUFFER_HARDWARE);
     }
 
     if (threading) {
@@ -203,14 +353,107 @@ void _init() {
 }
 
 #ifndef NOZIP
+zip *takeZip() {
+    std::unique_lock<std::mutex> lk(zipLock);
+    if (zipHandles.size() > 0) {
+        zip *zipFile = zipHandles.back();
+        zipHandles.pop_back();
+        return zipFile;
+    }
+    lk.unlock();
+    zip *zipFile = zip_open(zipPackage.c_str(), 0, NULL);
+    if (zipFile == NULL) {
+        throw std::runtime_error("Could not open zip file " + zipPackage);
+    }
+    return zipFile;
+}
+
+void returnZip(zip *zipFile) {
+    std::lock_guard<std::mutex> lk(zipLock);
+    zipHandles.push_back(zipFile);
+}
+
+void closeZips() {
+    std::lock_guard<std::mutex> lk(zipLock);
+    for (auto zipFile : zipHandles) {
+        zip_close(zipFile);
+    }
+    zipHandles.clear();
+    zipPackage.clear();
+}
+
+std::string zipWeightName(unsigned int fileIndex, unsigned int channel) {
+    return "weights/" + std::to_string(fileIndex) + "-" + std::to_string(channel) + ".bin";
+}
+
+/**
+ * Decompresses a prepared weight block of a version 2 zip package straight
+ * into its weight buffer
+ */
+void readZipWeights(unsigned int fileIndex, unsigned int channel, ExtMemWord *dst, size_t size) {
+    std::string const name = zipWeightName(fileIndex, channel);
+    zip *zipFile = takeZip();
+    struct zip_stat stats;
+    zip_stat_init(&stats);
+    zip_file *f = NULL;
+    if (zip_stat(zipFile, name.c_str(), 0, &stats) == 0 && stats.size == size) {
+        f = zip_fopen(zipFile, name.c_str(), 0);
+    }
+    if (f == NULL) {
+        returnZip(zipFile);
+        throw std::runtime_error("Could not find " + name + " of " + std::to_string(size) + " bytes in zip file!");
+    }
+    zip_int64_t const read = zip_fread(f, (void *) dst, size);
+    zip_fclose(f);
+    returnZip(zipFile);
+    if (read < 0 || (size_t) read != size) {
+        throw std::runtime_error("Could not decompress " + name + " from zip file!");
+    }
+}
+
+/**
+ * Adds the loaded weights as prepared blocks to a zip package, which turns
+ * it into a self contained version 2 package
+ */
+void writeZipWeights(char const *zipPath) {
+    zip *zipFile = zip_open(zipPath, ZIP_CREATE, NULL);
+    if (zipFile == NULL) {
+        throw std::runtime_error("Could not open zip file " + std::string(zipPath));
+    }
+    WeightTable const &table = adapter->getWeightTable();
+    unsigned int const first = layers->getBinparamSkip();
+    for (unsigned int index = 0; index < table.size(); index++) {
+        for (unsigned int channel = 0; channel < table.channels(); channel++) {
+            WeightTable::Entry const &entry = table.at(index, channel);
+            std::string const name = zipWeightName(first + index, channel);
+            // the buffers stay valid until zip_close writes the package
+            zip_source *source = zip_source_buffer(zipFile, (void const *) entry.buffer, entry.size, 0);
+            if (source == NULL || zip_file_add(zipFile, name.c_str(), source, ZIP_FL_OVERWRITE) < 0) {
+                zip_source_free(source);
+                std::string const error(zip_strerror(zipFile));
+                zip_close(zipFile);
+                throw std::runtime_error("Could not add " + name + " to zip file: " + error);
+            }
+        }
+    }
+    if (zip_close(zipFile) < 0) {
+        throw std::runtime_error("Could not write zip file " + std::string(zipPath));
+    }
+}
+
 void initAcceleratorZip(char const *zipPath) {
     if (initialized)
         return;
 
     static const std::pair<char const *, std::function<void(std::vector<char> &)>> extractFiles[] = {
         { "bitstream" , [](std::vector<char> &buffer){
+            if (!OffloadAdapter::configuresFabric()) {
+                return;
+            }
             stdOut << "Loading Bitstream from zip..." << std::endl;
-            GeneralUtils::configureFabric(buffer);
+            if (!GeneralUtils::configureFabric(buffer)) {
+                stdOut << "Bitstream is configured already" << std::endl;
+            }
         }},
         { "network.json" , [](std::vector<char> &buffer){
             stdOut << "Loading network json from zip..." << std::endl;
@@ -242,9 +485,28 @@ void initAcceleratorZip(char const *zipPath) {
 
         extractFile.second(buffer);
     }
-    zip_close(zipFile);
 
-    _init();
+    // version 2 packages carry the prepared weight blocks
+    bool weights = false;
+    zip_int64_t const entries = zip_get_num_entries(zipFile, 0);
+    for (zip_int64_t i = 0; i < entries && !weights; i++) {
+        char const *name = zip_get_name(zipFile, i, 0);
+        weights = (name && std::string(name).compare(0, 8, "weights/") == 0);
+    }
+    zipPackage = zipPath;
+    returnZip(zipFile);
+
+    if (weights) {
+        stdOut << "Loading weights from zip..." << std::endl;
+        weightReader = readZipWeights;
+    }
+    try {
+        _init();
+    } catch(...) {
+        weightReader = nullptr;
+        closeZips();
+        throw;
+    }
 }
 #endif
 
@@ -265,69 +527,90 @@ void deinitAccelerator() {
     if (!initialized)
         return;
 
+    // pending jobs and views return their buffers, before the pool is gone
     jobber.reset();
-    adapter.reset();
-    layers.reset();
-    network.reset();
     splitBuffers.clear();
     testBuffers.clear();
     resultBuffers.clear();
     concatBuffers.clear();
+    mergeBuffers.clear();
+    adapter.reset();
+    layers.reset();
+    network.reset();
+    // lazy loading reads weights from the zip package until here
+    weightReader = nullptr;
+#ifndef NOZIP
+    closeZips();
+#endif
     initialized = false;
 }
 
 void inference(unsigned int const batch = 1) {
-    unsigned int layerIndex = 0;
-    bool splitMode = false;
-    unsigned int splitIndex = 0;
-    unsigned int splitWeightOffset = 0;
     GeneralUtils::chrono_t timer = GeneralUtils::getTimer();
-    std::vector<Layers::Layer>::const_iterator layerIter = layers->begin();
-    std::vector<Layers::Layer>::const_iterator layerSplitIter = layers->end();
-    while (layerIter != layers->end()) {
-        Layers::Layer const &layer = (*layerIter);
-        Layers::Layer const &nextLayer = ((layerIter + 1) == layers->end()) ? layers->getNoneLayer() : (*(layerIter + 1));
-        if (layer.layer & Layers::split) {
+    std::vector<Layers::Step> const &steps = layers->getSteps();
+    for (auto const &step : steps) {
+        unsigned int const layerIndex = step.layer;
+        unsigned int const splitIndex = step.split;
+        unsigned int const splitWeightOffset = step.weightOffset;
+        Layers::Layer const &layer = layers->getLayer(layerIndex);
+        Layers::Layer const &nextLayer = ((layerIndex + 1) == layers->size()) ? layers->getNoneLayer() : layers->getLayer(layerIndex + 1);
+        if ((layer.layer & Layers::split) && step.sliceIn) {
+            stdOut << "\t" << layer.function << "[" << layerIndex << "]"  << std::endl;
+            // the conv layers read their group from the split source, keep
+            // it in the first split buffer for all split runs
+            for (unsigned int k = 0; step.first && (k < batch); k++) {
+                stdOut << "\t> Keep split source of batch image " << k << "..." << std::endl;
+                testBuffers[k]->waitPending();
+                OffloadUtils::swap(*splitBuffers[k][0], *testBuffers[k]);
+            }
+        } else if (layer.layer & Layers::split) {
             stdOut << "\t" << layer.function << "[" << layerIndex << "]"  << std::endl;
             for (unsigned int k = 0; k < batch; k++) {
                 stdOut << "\t> Prepare new buffers for batch image " << k << " and split run " << splitIndex << "..." << std::endl;
                 testBuffers[k]->waitPending();
-                testBuffers[k]->setTarget(1);
-                jobber->add([splitMode, k, splitIndex, &layer](){
-                    if (!splitMode) {
-                        GeneralUtils::chrono_t timer = GeneralUtils::getTimer();
+                OffloadAdapter::Pending pending = testBuffers[k]->pend();
+                if (step.first) {
+                    // one pass over the source fills all split buffers, the
+                    // rows are spread over the workers, every job keeps the
+                    // split buffers pending until its rows are written
+                    unsigned int const rowJobs = std::max(1u, std::min(threading ? threadCount : 1u, layer.inDim));
+                    for (unsigned int j = 0; j < rowJobs; j++) {
+                        unsigned int const firstRow = (j * layer.inDim) / rowJobs;
+                        unsigned int const lastRow = ((j + 1) * layer.inDim) / rowJobs;
+                        std::vector<OffloadAdapter::Pending> splitPending;
                         for (unsigned int s = 0; s < layer.split; s++) {
-                            OffloadUtils::split(*splitBuffers[k][s], *testBuffers[k], layer, s);
+                            splitPending.push_back(splitBuffers[k][s]->pend());
                         }
-                        splitTime += GeneralUtils::getTime(timer);
+                        jobber->add([k, &layer, firstRow, lastRow, splitPending, pending](){
+                            GeneralUtils::chrono_t timer = GeneralUtils::getTimer();
+                            OffloadUtils::splitAll(splitBuffers[k], *testBuffers[k], layer, firstRow, lastRow);
+                            splitTime += GeneralUtils::getTime(timer);
+                        }, threading);
                     }
+                }
+                jobber->add([k, splitIndex, &layer, pending](){
+                    OffloadUtils::waitOrWork(*jobber, *splitBuffers[k][splitIndex]);
                     GeneralUtils::chrono_t timer = GeneralUtils::getTimer();
-                    OffloadUtils::memcpy(*testBuffers[k], *splitBuffers[k][splitIndex], layer.outSize);
-                    OffloadUtils::down(*testBuffers[k]);
+                    OffloadUtils::memcpy(*testBuffers[k], *splitBuffers[k][splitIndex], layer.outSize, *jobber, threading);
                     splitBufferTime += GeneralUtils::getTime(timer);
                 }, threading);
             }
-            if (!splitMode) {
-                layerSplitIter = layerIter;
-                splitMode = true;
-                splitIndex = 0;
-                splitWeightOffset = 0;
-            }
-        } else if (layer.layer & Layers::merge) {
-            stdOut << "\t" << layer.function << "[" << layerIndex << "]"  << std::endl;
-            if ( splitIndex < layer.merge - 1) {
-                stdOut << "\t> Return to split layer..." << std::endl;
-                splitIndex++;
-                splitWeightOffset += layer.weightIndex;
-                layerIter = layerSplitIter;
-                continue;
-            }
-            splitMode = false;
-            splitIndex = 0;
-            splitWeightOffset = 0;
         } else if (layer.layer & Layers::conv) {
             stdOut << "\t" << layer.function << "[" << layerIndex << "]"  << std::endl;
             stdOut << "\t> Iterations: " << layer.iterations << std::endl;
+            // the input buffers stay pending from the first iteration until
+            // the job that writes the layer result back releases the token
+            std::vector<OffloadAdapter::Pending> inputPending(batch);
+            OffloadAdapter::ChannelSlice slice;
+            slice.sliceIn = step.sliceIn;
+            slice.sliceOut = step.sliceOut;
+            slice.inOffset = step.inOffset;
+            slice.outOffset = step.outOffset;
+            slice.inStride = step.inStride;
+            slice.outStride = step.outStride;
+            // every iteration writes its output channels into the concat buffer
+            bool const tileOutput = step.tileOutput;
+            unsigned int const batchImages = network->hasBatchOffload() ? OFFLOAD_MAX_IMAGES : 1;
                 for (unsigned int j = 0; j < layer.iterations; j++) {
                     if (layers->useBinparams()) {
                         stdOut << "\t> [" << j << "] Loading weights: " << layer.weightIndex + j + splitWeightOffset << std::endl;
@@ -335,23 +618,61 @@ void inference(unsigned int const batch = 1) {
                         adapter->offloadWeights(layer, j + splitWeightOffset);
                         adapter->exec();
                         weightsTime += GeneralUtils::getTime(weightsTimer);
+                        if (network->hasWeightPrefetch()) {
+                            // the next weights stream into the shadow bank
+                            // while this iteration computes
+                            if (j + 1 < layer.iterations) {
+                                adapter->prefetchWeights(layer, j + 1 + splitWeightOffset);
+                            } else if (step.nextConv < steps.size()) {
+                                Layers::Step const &next = steps[step.nextConv];
+                                adapter->prefetchWeights(layers->getLayer(next.layer), next.weightOffset);
+                            }
+                        }
                     }
                     stdOut << "\t> [" << j << "] Offloading..." << std::endl;
-                    for (unsigned int k = 0; k < batch; k++) {
+                    if (tileOutput) {
+                        slice.sliceOut = true;
+                        slice.outOffset = j * layer.OFMCh;
+                    }
+                    // a batched offload computes the layer for a group of
+                    // images in one invocation, otherwise the groups are single images
+                    for (unsigned int first = 0; first < batch; first += batchImages) {
+                        unsigned int const last = std::min(batch, first + batchImages);
                         GeneralUtils::chrono_t offloadTimer = GeneralUtils::getTimer();
-                        OffloadAdapter::ExtMemBuffer &inputBuffer  = *(testBuffers[k]);
-                        OffloadAdapter::ExtMemBuffer &outputBuffer = adapter->getBuffer(EXTMEMBUFFER_HARDWARE);
+                        std::vector<OffloadAdapter::BufferView> resultViews(last - first);
+                        std::vector<OffloadAdapter::BufferView> inputViews(last - first);
+                        std::vector<OffloadAdapter::BufferView> outputViews(last - first);
+                        for (unsigned int k = first; k < last; k++) {
+                            // sliced layers read the split source and write the
+                            // merge buffer, the result still goes to testBuffers
+                            OffloadAdapter::BufferView resultBuffer = testBuffers[k];
+                            OffloadAdapter::BufferView outputBuffer = slotBuffer(step.outSlot, k);
 
-                        if (j == 0) {
-                            inputBuffer.waitPending();
-                            inputBuffer.setTarget(1);
+                            if (j == 0) {
+                                resultBuffer->waitPending();
+                                inputPending[k] = resultBuffer->pend();
+                            }
+                            if (slice.sliceOut && (j == 0) && (tileOutput || splitIndex == 0)) {
+                                outputBuffer->waitPending();
+                            }
+                            resultViews[k - first] = resultBuffer;
+                            inputViews[k - first] = slotBuffer(step.inSlot, k);
+                            outputViews[k - first] = outputBuffer;
                         }
 
                         prepareTime += GeneralUtils::getTime(offloadTimer);
-                        stdOut << "\t> [" << j << "] Process image " << k << "... ";
+                        stdOut << "\t> [" << j << "] Process image " << first;
+                        if (last - first > 1) {
+                            stdOut << " to " << (last - 1);
+                        }
+                        stdOut << "... ";
                         offloadTimer = GeneralUtils::getTimer();
 
-                        adapter->offload(inputBuffer, outputBuffer, layer);
+                        if (last - first > 1) {
+                            adapter->offload(inputViews, outputViews, layer, slice);
+                        } else {
+                            adapter->offload(inputViews[0], outputViews[0], layer, slice);
+                        }
                         adapter->execAsync();
 
                         do {
@@ -366,71 +687,101 @@ void inference(unsigned int const batch = 1) {
                         offloadTime += GeneralUtils::getTime(offloadTimer);
                         stdOut << " done" << std::endl;
 
-                        if (layer.iterations > 1) {
-                            OffloadAdapter::ExtMemBuffer &concatBuffer = *(concatBuffers[k]);
-                            if (j == 0) {
-                                concatBuffer.setTarget(layer.iterations);
-                            }
-                            jobber->add([&inputBuffer, &outputBuffer, &concatBuffer, &layer, j](){
-                                    GeneralUtils::chrono_t timer = GeneralUtils::getTimer();
-                                    OffloadUtils::concat(concatBuffer, outputBuffer, layer, j);
-                                    outputBuffer.release();
-                                    concatTime += GeneralUtils::getTime(timer);
-                                    if(OffloadUtils::down(concatBuffer)) {
-                                        timer = GeneralUtils::getTimer();
-                                        OffloadUtils::swpcpy(inputBuffer, concatBuffer, layer.inSize);
-                                        OffloadUtils::down(inputBuffer);
-                                        swpcpyTime += GeneralUtils::getTime(timer);
-                                    }
-                                }, threading || (j+1 < layer.iterations));
-                        } else {
-                            if (nextLayer.layer & Layers::merge) {
-                                OffloadAdapter::ExtMemBuffer &mergeBuffer = *(mergeBuffers[k]);
-                                if (splitIndex == 0) {
-                                    mergeBuffer.waitPending();
-                                    mergeBuffer.setTarget(nextLayer.merge);
+                        for (unsigned int k = first; k < last; k++) {
+                            OffloadAdapter::BufferView resultBuffer = resultViews[k - first];
+                            OffloadAdapter::BufferView inputBuffer  = inputViews[k - first];
+                            OffloadAdapter::BufferView outputBuffer = outputViews[k - first];
+                            if (tileOutput) {
+                                // the hardware wrote the tile into the concat buffer
+                                if (j + 1 == layer.iterations) {
+                                    OffloadAdapter::Pending pending = std::move(inputPending[k]);
+                                    OffloadAdapter::Pending concatPending = outputBuffer->pend();
+                                    jobber->add([resultBuffer, outputBuffer, pending, concatPending, &layer](){
+                                            GeneralUtils::chrono_t timer = GeneralUtils::getTimer();
+                                            OffloadUtils::swpcpy(*resultBuffer, *outputBuffer, layer.outSize, *jobber, threading);
+                                            swpcpyTime += GeneralUtils::getTime(timer);
+                                        }, threading);
+                                    concatPending.reset();
+                                }
+                            } else if (layer.iterations > 1) {
+                                OffloadAdapter::BufferView concatBuffer = concatBuffers[k];
+                                OffloadAdapter::Pending concatPending = concatBuffer->pend();
+                                jobber->add([outputBuffer, concatBuffer, concatPending, &layer, j](){
+                                        GeneralUtils::chrono_t timer = GeneralUtils::getTimer();
+                                        OffloadUtils::concat(*concatBuffer, *outputBuffer, layer, j);
+                                        concatTime += GeneralUtils::getTime(timer);
+                                    }, threading || (j+1 < layer.iterations));
+                                // only the job may hold the token, or the write back below waits forever
+                                concatPending.reset();
+                                if (j + 1 == layer.iterations) {
+                                    OffloadAdapter::Pending pending = std::move(inputPending[k]);
+                                    jobber->add([inputBuffer, concatBuffer, pending, &layer](){
+                                            OffloadUtils::waitOrWork(*jobber, *concatBuffer);
+                                            GeneralUtils::chrono_t timer = GeneralUtils::getTimer();
+                                            OffloadUtils::swpcpy(*inputBuffer, *concatBuffer, layer.outSize, *jobber, threading);
+                                            swpcpyTime += GeneralUtils::getTime(timer);
+                                        }, threading);
                                 }
+                            } else {
+                                if (slice.sliceOut) {
+                                    // the hardware wrote the group into the merge buffer
+                                    if (splitIndex + 1 == nextLayer.merge) {
+                                        stdOut << "\t> Swap merged layer back to batch image " << k << "..." << std::endl;
+                                        OffloadAdapter::Pending pending = std::move(inputPending[k]);
+                                        OffloadAdapter::Pending mergePending = outputBuffer->pend();
+                                        jobber->add([resultBuffer, outputBuffer, pending, mergePending, &nextLayer](){
+                                            GeneralUtils::chrono_t timer = GeneralUtils::getTimer();
+                                            OffloadUtils::swpcpy(*resultBuffer, *outputBuffer, nextLayer.outSize, *jobber, threading);
+                                            swapTime += GeneralUtils::getTime(timer);
+                                        }, threading);
+                                        mergePending.reset();
+                                    } else {
+                                        inputPending[k].reset();
+                                    }
+                                } else if (nextLayer.layer & Layers::merge) {
+                                    OffloadAdapter::BufferView mergeBuffer = mergeBuffers[k];
+                                    if (splitIndex == 0) {
+                                        mergeBuffer->waitPending();
+                                    }
+                                    OffloadAdapter::Pending mergePending = mergeBuffer->pend();
 
-                                stdOut << "\t> Merging split " << splitIndex << " of batch image " << k << "..." << std::endl;
-                                jobber->add([k, splitIndex, &mergeBuffer, &outputBuffer, &layer, &nextLayer](){
-                                    GeneralUtils::chrono_t timer = GeneralUtils::getTimer();
-                                    OffloadUtils::mergeBuffer(mergeBuffer.buffer, outputBuffer.buffer, nextLayer, splitIndex);
-                                    outputBuffer.release();
-                                    OffloadUtils::down(mergeBuffer);
-                                    mergeTime += GeneralUtils::getTime(timer);
-                                }, threading || splitIndex < (nextLayer.merge - 1));
-
-                                if (splitIndex + 1 == nextLayer.merge) {
-                                    stdOut << "\t> Copy merged layer back to batch image " << k << "..." << std::endl;
-                                    jobber->add([k, &inputBuffer, &mergeBuffer, &nextLayer](){
-                                        mergeBuffer.waitPending();
+                                    stdOut << "\t> Merging split " << splitIndex << " of batch image " << k << "..." << std::endl;
+                                    jobber->add([splitIndex, mergeBuffer, mergePending, outputBuffer, &nextLayer](){
                                         GeneralUtils::chrono_t timer = GeneralUtils::getTimer();
-                                        OffloadUtils::memcpy(inputBuffer, mergeBuffer, nextLayer.outSize);
-                                        OffloadUtils::down(inputBuffer);
+                                        OffloadUtils::mergeBuffer(mergeBuffer->buffer, outputBuffer->buffer, nextLayer, splitIndex);
                                         mergeTime += GeneralUtils::getTime(timer);
-                                    }, threading);
+                                    }, threading || splitIndex < (nextLayer.merge - 1));
+                                    mergePending.reset();
+
+                                    if (splitIndex + 1 == nextLayer.merge) {
+                                        stdOut << "\t> Copy merged layer back to batch image " << k << "..." << std::endl;
+                                        OffloadAdapter::Pending pending = std::move(inputPending[k]);
+                                        jobber->add([resultBuffer, mergeBuffer, pending, &nextLayer](){
+                                            OffloadUtils::waitOrWork(*jobber, *mergeBuffer);
+                                            GeneralUtils::chrono_t timer = GeneralUtils::getTimer();
+                                            OffloadUtils::memcpy(*resultBuffer, *mergeBuffer, nextLayer.outSize, *jobber, threading);
+                                            mergeTime += GeneralUtils::getTime(timer);
+                                        }, threading);
+                                    } else {
+                                        // the input buffer can be reused by the split layer
+                                        inputPending[k].reset();
+                                    }
+
                                 } else {
-                                    // the input buffer can be reused by the split layer
-                                    OffloadUtils::down(inputBuffer);
+                                    OffloadAdapter::Pending pending = std::move(inputPending[k]);
+                                    jobber->add([resultBuffer, outputBuffer, pending](){
+                                            GeneralUtils::chrono_t timer = GeneralUtils::getTimer();
+                                            OffloadUtils::swap(*resultBuffer, *outputBuffer);
+                                            swapTime += GeneralUtils::getTime(timer);
+                                        }, threading);
                                 }
-
-                            } else {
-                                jobber->add([&inputBuffer, &outputBuffer](){
-                                        GeneralUtils::chrono_t timer = GeneralUtils::getTimer();
-                                        OffloadUtils::swap(inputBuffer, outputBuffer);
-                                        OffloadUtils::down(inputBuffer);
-                                        outputBuffer.release();
-                                        swapTime += GeneralUtils::getTime(timer);
-                                    }, threading);
                             }
                         }
                     }
                 } // for layer.iterations
-            layerIndex++;
             stdOut << std::endl;
         } //end if conv_layer
-        std::advance(layerIter, 1);
-    } // for layers
+    } // for steps
     duration += GeneralUtils::getTime(timer);
     stdOut << std::endl;
 }
@@ -442,10 +793,14 @@ void singleInference(char *in, size_t const inSize, char *out, size_t const outS
     stdOut << "Got input with " << inSize << " bytes..." << std::endl;
     if (inSize != layers->getInMem()) {
         stdOut << "Padding downto/to " <<  layers->getInMem() << " bytes..." << std::endl;
-        OffloadUtils::padTo((char *) testBuffers[0]->buffer, layers->getInMem(), in, inSize, layers->getInDim() * layers->getInDim());
+        unsigned int const elements = layers->getInDim() * layers->getInDim();
+        if (!inputPadPlan.matches(layers->getInMem(), inSize, elements)) {
+            inputPadPlan = OffloadUtils::padPlan(layers->getInMem(), inSize, elements);
+        }
+        OffloadUtils::padTo(inputPadPlan, (char *) testBuffers[0]->buffer, in, *jobber, threading);
     } else {
         stdOut << "Memcpy to input buffer... " << std::endl;
-        OffloadUtils::memcpy((char *) testBuffers[0]->buffer, in, inSize);
+        OffloadUtils::parallelMemcpy((char *) testBuffers[0]->buffer, in, inSize, *jobber, threading);
     }
     inference(1);
     testBuffers[0]->wait();
@@ -453,22 +808,138 @@ void singleInference(char *in, size_t const inSize, char *out, size_t const outS
     stdOut << "Got output with " << outSize << " bytes..." << std::endl;
     if (outSize != layers->getOutMem()) {
         stdOut << "Padding downto/to " <<  layers->getOutMem() << " bytes..." << std::endl;
-        OffloadUtils::padTo(out, outSize, (char *) testBuffers[0]->buffer, layers->getOutMem(), layers->getOutDim() * layers->getOutDim());
+        unsigned int const elements = layers->getOutDim() * layers->getOutDim();
+        if (!outputPadPlan.matches(outSize, layers->getOutMem(), elements)) {
+            outputPadPlan = OffloadUtils::padPlan(outSize, layers->getOutMem(), elements);
+        }
+        OffloadUtils::padTo(outputPadPlan, out, (char *) testBuffers[0]->buffer, *jobber, threading);
     } else {
         stdOut << "Memcpy to output buffer... " << std::endl;
-        OffloadUtils::memcpy(out, (char *) testBuffers[0]->buffer, outSize);
+        OffloadUtils::parallelMemcpy(out, (char const *) testBuffers[0]->buffer, outSize, *jobber, threading);
     }
 }
 
+/**
+ * see packedInference, the shapes are checked before any job is started
+ * so the pack and unpack jobs cannot throw on the workers
+ */
+static void _packedInference(unsigned char const *in, unsigned int const inChannels, unsigned int const inDim, float *out, unsigned int const outChannels, unsigned int const outDim) {
+    if (inDim != layers->getInDim() || outDim != layers->getOutDim()) {
+        throw std::runtime_error("Packed inference expects " + std::to_string(layers->getInDim()) + " input and " + std::to_string(layers->getOutDim()) + " output dimension!");
+    }
+    unsigned int const activationBits = network->getActivationBits();
+    unsigned int const inPixels = inDim * inDim;
+    unsigned int const outPixels = outDim * outDim;
+    size_t const inStride = layers->getInMem() / inPixels;
+    size_t const outStride = layers->getOutMem() / outPixels;
+    if (activationBits > 8 || (size_t) inChannels * activationBits > inStride * 8 || (size_t) outChannels * activationBits > outStride * 8) {
+        throw std::runtime_error("Packed inference channels exceed the accelerator buffers!");
+    }
+    char *buffer = (char *) testBuffers[0]->buffer;
+
+    stdOut << "Packing " << inChannels << " input channels with " << activationBits << " bits..." << std::endl;
+    for (unsigned int row = 0; row < inDim; row++) {
+        unsigned int const first = row * inDim;
+        auto pack = [buffer, in, inStride, inPixels, inChannels, inDim, activationBits, first](){
+            OffloadUtils::packActivations(buffer + (first * inStride), inStride, in + first, inPixels, inChannels, inDim, activationBits);
+        };
+        if (threading) {
+            jobber->add(pack);
+        } else {
+            pack();
+        }
+    }
+    if (threading) {
+        while (jobber->work()) {}
+        jobber->wait();
+    }
+    inference(1);
+    testBuffers[0]->wait();
+    testBuffers[0]->waitPending();
+    stdOut << "Unpacking " << outChannels << " output channels..." << std::endl;
+    for (unsigned int row = 0; row < outDim; row++) {
+        unsigned int const first = row * outDim;
+        auto unpack = [buffer, out, outStride, outChannels, outDim, activationBits, first](){
+            OffloadUtils::unpackActivations(out + ((size_t) first * outChannels), buffer + (first * outStride), outStride, outChannels, outDim, activationBits);
+        };
+        if (threading) {
+            jobber->add(unpack);
+        } else {
+            unpack();
+        }
+    }
+    if (threading) {
+        while (jobber->work()) {}
+        jobber->wait();
+    }
+}
 
-bool toUnsignedInt(char *from, unsigned int &to) {
-    std::istringstream ss(from);
-    unsigned int test;
-    if (ss >> test) {
-        to = test;
-        return true;
+/**
+ * runs one inference on 8 bit planar input (channel, row, column) and
+ * returns float output (row, column, channel). The activations are packed
+ * directly into and decoded directly from the accelerator buffer, row wise
+ * on the worker threads. Exceptions must not cross the C interface, they
+ * are turned into an error code, see getLastError
+ * @return 0 on success, -1 on error
+ */
+int packedInference(unsigned char const *in, unsigned int const inChannels, unsigned int const inDim, float *out, unsigned int const outChannels, unsigned int const outDim) {
+    try {
+        if (!initialized) {
+            throw std::runtime_error("Accelerator is not initialized!");
+        }
+        _packedInference(in, inChannels, inDim, out, outChannels, outDim);
+    } catch (std::exception const &e) {
+        lastError = e.what();
+        return -1;
+    } catch (...) {
+        lastError = "Unknown error";
+        return -1;
     }
-    return false;
+    return 0;
+}
+
+/**
+ * @return message of the last call that returned an error code
+ */
+char const *getLastError() {
+    return lastError.c_str();
+}
+
+
+/**
+ * compares the copy and fill routines on accelerator memory, every
+ * routine runs on aligned, source shifted and target shifted buffers
+ * @param size bytes per run
+ */
+void benchmarkCopies(size_t const size) {
+    unsigned int const rounds = 16;
+    size_t const bufferSize = ((size + 16) / sizeof(ExtMemWord)) * sizeof(ExtMemWord);
+    char *source = (char *) adapter->malloc(bufferSize);
+    char *target = (char *) adapter->malloc(bufferSize);
+    std::vector<std::pair<std::string, std::function<void(size_t, size_t)>>> routines = {
+        {"memcpy", [source, target, size](size_t to, size_t from){ OffloadUtils::memcpy(target + to, source + from, size); }},
+        {"deviceMemcpy", [source, target, size](size_t to, size_t from){ OffloadUtils::deviceMemcpy(target + to, source + from, size); }},
+        {"memset", [target, size](size_t to, size_t){ OffloadUtils::memset(target + to, 0x5a, size); }},
+        {"deviceMemset", [target, size](size_t to, size_t){ OffloadUtils::deviceMemset(target + to, 0x5a, size); }},
+        {"parallelMemcpy", [source, target, size](size_t to, size_t from){ OffloadUtils::parallelMemcpy(target + to, source + from, size, *jobber, threading); }},
+        {"parallelMemset", [target, size](size_t to, size_t){ OffloadUtils::parallelMemset(target + to, 0x5a, size, *jobber, threading); }}
+    };
+    std::vector<std::pair<size_t, size_t>> const offsets = {{0, 0}, {0, 3}, {5, 0}, {5, 3}};
+    OffloadUtils::deviceMemset(source, 0x3c, bufferSize);
+    stdOut << verboseIgnore << "Benchmarking " << size << " bytes of accelerator memory..." << std::endl;
+    for (auto const &routine : routines) {
+        for (auto const &offset : offsets) {
+            GeneralUtils::chrono_t timer = GeneralUtils::getTimer();
+            for (unsigned int r = 0; r < rounds; r++) {
+                routine.second(offset.first, offset.second);
+            }
+            signed long long const time = std::max(GeneralUtils::getTime(timer), 1LL);
+            stdOut << "\t" << std::setw(14) << std::left << routine.first << " target +" << offset.first << " source +" << offset.second << ": "
+                   << std::setw(10) << std::right << (time / rounds) << " us " << std::setw(10) << ((size * rounds) / time) << " MB/s" << std::endl;
+        }
+    }
+    adapter->free((ExtMemWord *) target);
+    adapter->free((ExtMemWord *) source);
 }
 
 void printHelp(char opt = 0, char *optarg = NULL) {
@@ -487,6 +958,15 @@ void printHelp(char opt = 0, char *optarg = NULL) {
     stdErr << "\t -n <path> \t Network description json file" << std::endl;
     stdErr << "\t -l <path> \t Layers description json file" << std::endl;
     stdErr << "\t -z <path> \t Zip package (disables -l and -n)" << std::endl;
+    stdErr << "\t -p <pages> \t Local buffer pages: default, transparent or explicit" << std::endl;
+    stdErr << "\t -w <path> \t Write the loaded weights into a weight pack and exit" << std::endl;
+    stdErr << "\t -Z <path> \t Add the loaded weights to a zip package and exit" << std::endl;
+    stdErr << "\t -C <path> \t Compile the layers json into a layers plan and exit, the plan can be used in place of the layers json" << std::endl;
+    stdErr << "\t -B <KiB> \t Benchmark copies and fills on accelerator memory and exit" << std::endl;
+    stdErr << "\t -c <dir> \t Weight cache directory" << std::endl;
+    stdErr << "\t -e <loading> \t Weight loading: eager, lazy or prefetch" << std::endl;
+    stdErr << "\t -m <MiB> \t Resident weight budget for lazy and prefetch loading" << std::endl;
+    stdErr << "\t -k <KiB> \t Chunk size of parallel buffer copies, 0 copies on one thread" << std::endl;
     stdErr << "\t -v \t\t increase verbosity" << std::endl;
     if (rand() % 100 < 20) {
         stdErr << "\t -a \t\t baaad timings" << std::endl;
@@ -511,8 +991,14 @@ int main(int argc, char **argv) {
     std::string networkJsonPath;
     std::string layersJsonPath;
     std::string zipPath;
+    std::string packPath;
+    std::string zipOutPath;
+    std::string planPath;
+    unsigned int benchmarkKiB = 0;
+    unsigned int copyChunk = 0;
     unsigned int result = 0;
     unsigned int correctImages  = 0;
+    OffloadAdapter::BufferView inputImagePadded;
 
     threadCount = std::thread::hardware_concurrency();
     threading = true;
@@ -525,8 +1011,13 @@ int main(int argc, char **argv) {
     if (env) {
         layersJsonPath = env;
     }
+    std::string envError;
+    if (!readEnvironment(envError)) {
+        stdErr << envError << std::endl;
+        return 1;
+    }
     int opt;
-    while ((opt = getopt(argc, argv, "ahvn:l:i:t:b:z:")) != -1) {
+    while ((opt = getopt(argc, argv, "ahvn:l:i:t:b:z:p:w:c:e:m:k:Z:C:B:")) != -1) {
         switch (opt) {
             case 'n':
                 networkJsonPath = optarg;
@@ -537,6 +1028,53 @@ int main(int argc, char **argv) {
             case 'z':
                 zipPath = optarg;
                 break;
+            case 'w':
+                packPath = optarg;
+                break;
+            case 'Z':
+                zipOutPath = optarg;
+                break;
+            case 'C':
+                planPath = optarg;
+                break;
+            case 'B':
+                if (!toUnsignedInt(optarg, benchmarkKiB) || benchmarkKiB == 0) {
+                    printHelp(opt, optarg);
+                    return 1;
+                }
+                break;
+            case 'c':
+                if (!GeneralUtils::dirExists(optarg)) {
+                    printHelp(opt, optarg);
+                    return 1;
+                }
+                weightCache = optarg;
+                break;
+            case 'e':
+                if (!toWeightLoading(optarg, weightLoading)) {
+                    printHelp(opt, optarg);
+                    return 1;
+                }
+                break;
+            case 'm':
+                if (!toUnsignedInt(optarg, weightBudget)) {
+                    printHelp(opt, optarg);
+                    return 1;
+                }
+                break;
+            case 'k':
+                if (!toUnsignedInt(optarg, copyChunk)) {
+                    printHelp(opt, optarg);
+                    return 1;
+                }
+                OffloadUtils::setCopyChunk((size_t) copyChunk * 1024);
+                break;
+            case 'p':
+                if (!toLocalPages(optarg, localPages)) {
+                    printHelp(opt, optarg);
+                    return 1;
+                }
+                break;
             case 'v':
                 verbose = true;
                 break;
@@ -590,6 +1128,29 @@ int main(int argc, char **argv) {
         }
     }
 
+    if (planPath.size() > 0) {
+        if (zipPath.size() > 0) {
+            stdErr << "A layers plan can only be compiled from a network and layers json file!" << std::endl;
+            return 1;
+        }
+        try {
+            // no accelerator needed, the plan only depends on both json files
+            Network planNetwork(networkJsonPath);
+            Layers planLayers(planNetwork, layersJsonPath);
+            planLayers.save(planPath);
+            stdOut << "Compiled " << planLayers.size() << " layers and " << planLayers.getSteps().size() << " steps to " << planPath << std::endl;
+        } catch (const std::exception &e) {
+            stdErr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (packPath.size() > 0 || zipOutPath.size() > 0) {
+        // a pack needs all weights resident
+        weightLoading = WEIGHTS_LOADING_EAGER;
+    }
+
     unsigned const int batchIterations = std::ceil((float) imageCount/ (float) batchSize);
 
     try {
@@ -622,6 +1183,32 @@ int main(int argc, char **argv) {
 
         stdOut << "Network is " << layers->getNetwork() << std::endl;
 
+        if (benchmarkKiB > 0) {
+            benchmarkCopies((size_t) benchmarkKiB * 1024);
+            deinitAccelerator();
+            return 0;
+        }
+
+        if (packPath.size() > 0 || zipOutPath.size() > 0) {
+            if (!layers->useBinparams()) {
+                throw std::runtime_error("Layers json does not use binparams, nothing to pack!");
+            }
+            if (packPath.size() > 0) {
+                stdOut << verboseIgnore << "Writing " << adapter->getWeightTable().size() << " weight rows to " << packPath << "..." << std::endl << verboseLevel;
+                WeightPack::write(packPath, adapter->getWeightTable(), layers->getBinparamSkip());
+            }
+            if (zipOutPath.size() > 0) {
+#ifndef NOZIP
+                stdOut << verboseIgnore << "Adding " << adapter->getWeightTable().size() << " weight rows to " << zipOutPath << "..." << std::endl << verboseLevel;
+                writeZipWeights(zipOutPath.c_str());
+#else
+                throw std::runtime_error("zip capability was not compiled in");
+#endif
+            }
+            deinitAccelerator();
+            return 0;
+        }
+
         if (layers->size() == 0) {
             throw std::runtime_error("There are no layers specified, maybe layer_skip is to high!");
         }
@@ -640,26 +1227,68 @@ int main(int argc, char **argv) {
         GeneralUtils::readBinaryFile(inputImage, imageFilename);
         stdOut << "read " << inputImage.size() << " bytes!" << std::endl;
 
-        OffloadAdapter::ExtMemBuffer &inputImagePadded = adapter->getBuffer(EXTMEMBUFFER_LOCAL);
-        if (inputImage.size() < layers->getInMem()) {
+        // compact buffers are smaller than the image files, which always
+        // hold MAX_IFM_CH channels per pixel
+        bool const compact = network->hasCompactActivations();
+        if (compact && (resultImage.size() != layers->getOutMem())) {
+            std::vector<char> compactImage(layers->getOutMem());
+            OffloadUtils::padTo(compactImage.data(), compactImage.size(), resultImage.data(), resultImage.size(), layers->getOutDim() * layers->getOutDim());
+            resultImage.swap(compactImage);
+        }
+        size_t const resultStride = compact ? layers->getPixelBytes(layers->getOutCh()) : 0;
+
+        inputImagePadded = adapter->getBuffer(EXTMEMBUFFER_LOCAL);
+        if ((inputImage.size() < layers->getInMem()) || (compact && (inputImage.size() != layers->getInMem()))) {
             stdOut << "Input image only contains " << inputImage.size() << " bytes, need a padding to " << layers->getInMem() << " bytes..." << std::endl;
-            OffloadUtils::padTo((char *) inputImagePadded.buffer, layers->getInMem(), (char *) inputImage.data(), inputImage.size() , layers->getInDim() * layers->getInDim());
+            OffloadUtils::padTo((char *) inputImagePadded->buffer, layers->getInMem(), (char *) inputImage.data(), inputImage.size() , layers->getInDim() * layers->getInDim());
         } else {
-            std::memcpy(inputImagePadded.buffer, inputImage.data(),  layers->getInMem());
+            std::memcpy(inputImagePadded->buffer, inputImage.data(),  layers->getInMem());
             stdOut << "Copied " << layers->getInMem() << " bytes from input image" << std::endl;
         }
 
+        // verification of a batch runs on the jobber while the next batch
+        // computes, it is reported before its result buffer is reused
+        std::vector<OffloadUtils::Verification> verifications(batchSize);
+        std::vector<long long> verificationImages(batchSize, -1);
+        auto reportVerification = [&](unsigned int const k) {
+            OffloadUtils::waitOrWork(*jobber, *resultBuffers[k]);
+            if (verificationImages[k] < 0) {
+                return;
+            }
+            OffloadUtils::Verification const &verification = verifications[k];
+            if (verification.correct()) {
+                stdOut << "Verification of image " << verificationImages[k] << " succeeded!" << std::endl;
+                correctImages++;
+            } else {
+                unsigned long long const correctPixels = verification.pixels - verification.wrongPixels;
+                stdErr << verboseIgnore << "Verification of image " << verificationImages[k] << " failed!" << std::endl;
+                stdErr << correctPixels << "/" << verification.pixels << " pixels are correct, accuracy " << std::fixed << std::setprecision(2) << (float) 100 * ((float) correctPixels / (float) verification.pixels) << "%" << std::endl;
+                stdErr << verification.wrongBits << " bit errors in " << verification.wrongChannels << " activations, per activation bit:";
+                for (auto const errors : verification.bitErrors) {
+                    stdErr << " " << errors;
+                }
+                stdErr << std::endl;
+                stdErr << verboseLevel;
+                for (unsigned int c = 0; c < verification.channelErrors.size(); c++) {
+                    if (verification.channelErrors[c] > 0) {
+                        stdErr << "channel " << c << ": " << verification.channelErrors[c] << " wrong pixels" << std::endl;
+                    }
+                }
+                result = 1;
+            }
+            verificationImages[k] = -1;
+        };
+
         stdOut << std::endl << std::endl;
         for (unsigned int i = 0; i < batchIterations; i++) {
             unsigned int const currentBatchSize = ((i * batchSize) + batchSize > imageCount) ? imageCount - (i * batchSize)  : batchSize;
             stdOut << verboseIgnore << "Batch run " << i << " processing " << currentBatchSize << " images" << std::endl << verboseLevel;
 
             for (unsigned int k = 0; k < currentBatchSize; k++) {
-                testBuffers[k]->setTarget(1);
-                jobber->add([k, &inputImagePadded](){
+                OffloadAdapter::Pending pending = testBuffers[k]->pend();
+                jobber->add([k, inputImagePadded, pending](){
                     GeneralUtils::chrono_t timer = GeneralUtils::getTimer();
-                    OffloadUtils::memcpy(*testBuffers[k], inputImagePadded, inputImagePadded.size());
-                    OffloadUtils::down(*testBuffers[k]);
+                    OffloadUtils::memcpy(*testBuffers[k], *inputImagePadded, inputImagePadded->size(), *jobber, threading);
                     inputTime += GeneralUtils::getTime(timer);
                 }, threading && inputTiming);
             }
@@ -667,31 +1296,28 @@ int main(int argc, char **argv) {
             inference(currentBatchSize);
 
             for (unsigned int k = 0; k < currentBatchSize; k++) {
+                reportVerification(k);
                 stdOut << "\t> Get result of image " << k << std::endl;
                 GeneralUtils::chrono_t timer = GeneralUtils::getTimer();
                 testBuffers[k]->waitPending();
-                OffloadUtils::memcpy(*resultBuffers[k], *testBuffers[k], layers->getOutMem());
+                OffloadUtils::memcpy(*resultBuffers[k], *testBuffers[k], layers->getOutMem(), *jobber, threading);
                 resultTime += GeneralUtils::getTime(timer);
                 stdOut << "\t> Copied " << layers->getOutMem() << " bytes from the result" << std::endl;
             }
 
-            for (int k = 0; k < currentBatchSize; k++) {
+            for (unsigned int k = 0; k < currentBatchSize; k++) {
                 // dump_to_file("/tmp/accel_out_" + std::to_string(k) + ".bin",(char *) resultBuffers[k]->buffer, layers->getOutMem());
-                unsigned int const currentImage = (i * batchSize) + k;
-                if (OffloadUtils::verifyBuffers((ExtMemWord *) resultImage.data(), resultBuffers[k]->buffer, *network, layers->getOutCh(), layers->getOutDim(), stdErr)) {
-                    stdOut << "Verification of image " << currentImage << " succeeded!" << std::endl;
-                    correctImages++;
-                } else {
-                    const unsigned long long outPixels = layers->getOutDim() * layers->getOutDim();
-                    unsigned long long const correctPixels = outPixels - OffloadUtils::tellPixels();
-                    stdErr << verboseIgnore << "Verification of image " << currentImage << " failed!" << std::endl;
-                    stdErr << correctPixels << "/" << outPixels << " pixels are correct, accuracy " << std::fixed << std::setprecision(2) << (float) 100 * ((float) correctPixels / (float) outPixels) << "%" << std::endl;
-                    stdErr << verboseLevel;
-                    result = 1;
-                }
+                verificationImages[k] = (i * batchSize) + k;
+                OffloadAdapter::Pending pending = resultBuffers[k]->pend();
+                jobber->add([k, &verifications, &resultImage, resultStride, pending](){
+                    verifications[k] = OffloadUtils::verify((ExtMemWord const *) resultImage.data(), resultBuffers[k]->buffer, *network, layers->getOutCh(), layers->getOutDim(), resultStride);
+                }, threading);
             }
             stdOut << std::endl;
         } // for batchIterations
+        for (unsigned int k = 0; k < batchSize; k++) {
+            reportVerification(k);
+        }
 
         duration += resultTime;
         if (inputTiming) {
@@ -717,8 +1343,10 @@ int main(int argc, char **argv) {
         stdOut << " ┗━Results    " << std::setw(maxLen) << resultTime      << " us, " << std::fixed << std::setprecision(2) << std::setw(maxLen) << ((float) resultTime      / 1000) << " ms, " << std::setw(maxLen - 3) << ((float) resultTime      / 1000000) << "s, " << std::setw(6) << ((float) resultTime      * 100 / duration) << "%" << std::endl;
         stdOut << "> " << std::fixed << std::setprecision(4) << (float) (1000000 * imageCount) / duration << " fps" << std::endl;
 
+        inputImagePadded.reset();
         deinitAccelerator();
     } catch(...) {
+        inputImagePadded.reset();
         deinitAccelerator();
         throw;
     }